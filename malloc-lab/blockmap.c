@@ -0,0 +1,65 @@
+/*
+ * blockmap.c - bit scans over the block-start map
+ */
+#include <string.h>
+#include <sys/mman.h>
+#include "blockmap.h"
+
+/* Bytes in each bitmap: one bit per granule of 4 GB */
+#define MAP_BYTES ((1ULL << 32) >> BM_SHIFT >> 3)
+
+char *blockmap_base;
+unsigned long long *blockmap_start;
+unsigned long long *blockmap_alloc;
+size_t blockmap_top;
+
+/*
+ * blockmap_init - Reserve the bitmaps once, and clear what the last
+ *     heap set
+ */
+int blockmap_init(void *base)
+{
+    void *p;
+
+    if (blockmap_start == NULL) {
+        p = mmap(NULL, 2 * MAP_BYTES, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED)
+            return -1;
+        blockmap_start = p;
+        blockmap_alloc = (unsigned long long *)((char *)p + MAP_BYTES);
+    }
+    memset(blockmap_start, 0, blockmap_top * sizeof(unsigned long long));
+    memset(blockmap_alloc, 0, blockmap_top * sizeof(unsigned long long));
+    blockmap_top = 0;
+    blockmap_base = base;
+    return 0;
+}
+
+/*
+ * blockmap_prev - Scan the start map down from the bit before bp. A
+ *     prologue always precedes a block, so the scan ends.
+ */
+char *blockmap_prev(void *bp)
+{
+    size_t bit = BM_BIT(bp), w = bit / 64;
+    unsigned long long bits = blockmap_start[w] & ((1ULL << (bit % 64)) - 1);
+
+    while (bits == 0)
+        bits = blockmap_start[--w];
+    return blockmap_base + ((w * 64 + 63 - __builtin_clzll(bits)) << BM_SHIFT);
+}
+
+/*
+ * blockmap_next - Scan the start map up from the bit after bp. An
+ *     epilogue always follows a block, so the scan ends.
+ */
+char *blockmap_next(void *bp)
+{
+    size_t bit = BM_BIT(bp) + 1, w = bit / 64;
+    unsigned long long bits = blockmap_start[w] & (~0ULL << (bit % 64));
+
+    while (bits == 0)
+        bits = blockmap_start[++w];
+    return blockmap_base + ((w * 64 + __builtin_ctzll(bits)) << BM_SHIFT);
+}
@@ -0,0 +1,78 @@
+/*
+ * blockmap.h - side bitmaps of block starts and allocation status
+ *
+ * Two bitmaps with one bit per 8-byte granule of the heap: the start
+ * map has the bit of every block's payload address set, and the alloc
+ * map the same bit of every allocated block. The block before or after
+ * an address is found with a bit scan over the start map, and whether
+ * it is allocated with one more bit, so the neighbors of a block can be
+ * examined without reading their boundary tags. Like the page map, the
+ * bitmaps reach 4 GB past the heap base; they are reserved address
+ * space, and only the part covering the heap is ever touched.
+ */
+#ifndef __BLOCKMAP_H_
+#define __BLOCKMAP_H_
+
+#include <stddef.h>
+
+#define BM_SHIFT 3               /* log2 of the granule */
+
+extern char *blockmap_base;
+extern unsigned long long *blockmap_start;
+extern unsigned long long *blockmap_alloc;
+extern size_t blockmap_top;      /* words below this may be non-zero */
+
+/*
+ * Empty the bitmaps for a heap at base, reserving them on first use.
+ * Returns 0, or -1 if they could not be reserved.
+ */
+int blockmap_init(void *base);
+
+/* Start of the block before bp, and of the block after bp */
+char *blockmap_prev(void *bp);
+char *blockmap_next(void *bp);
+
+#define BM_BIT(bp) ((size_t)((char *)(bp) - blockmap_base) >> BM_SHIFT)
+
+/* Record a block starting at bp, allocated or not */
+static inline void blockmap_mark(void *bp, int alloc)
+{
+    size_t bit = BM_BIT(bp), w = bit / 64;
+    unsigned long long m = 1ULL << (bit % 64);
+
+    blockmap_start[w] |= m;
+    if (alloc)
+        blockmap_alloc[w] |= m;
+    else
+        blockmap_alloc[w] &= ~m;
+    if (w >= blockmap_top)
+        blockmap_top = w + 1;
+}
+
+/* Forget the block starting at bp */
+static inline void blockmap_unmark(void *bp)
+{
+    size_t bit = BM_BIT(bp);
+    unsigned long long m = ~(1ULL << (bit % 64));
+
+    blockmap_start[bit / 64] &= m;
+    blockmap_alloc[bit / 64] &= m;
+}
+
+/* Does a block start at bp? */
+static inline int blockmap_is_start(const void *bp)
+{
+    size_t bit = BM_BIT(bp);
+
+    return (blockmap_start[bit / 64] >> (bit % 64)) & 1;
+}
+
+/* Is the block starting at bp allocated? */
+static inline int blockmap_is_alloc(const void *bp)
+{
+    size_t bit = BM_BIT(bp);
+
+    return (blockmap_alloc[bit / 64] >> (bit % 64)) & 1;
+}
+
+#endif /* __BLOCKMAP_H_ */
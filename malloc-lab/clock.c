@@ -1,5 +1,5 @@
 /* 
- * clock.c - Routines for using the cycle counters on x86, 
+ * clock.c - Routines for using the cycle counters on x86, x86-64,
  *           Alpha, and Sparc boxes.
  * 
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/times.h>
+#include <time.h>
 #include "clock.h"
 
 
@@ -21,55 +22,86 @@
  * You can verify this for yourself using gcc -v.
  *******************************************************/
 
-#if defined(__i386__)  
-/*******************************************************
- * Pentium versions of start_counter() and get_counter()
- *******************************************************/
+#if defined(__i386__) || defined(__x86_64__)
+/**************************************************************
+ * x86 and x86-64 versions of start_counter() and get_counter()
+ **************************************************************/
 
+#include <cpuid.h>
 
 /* $begin x86cyclecounter */
 /* Initialize the cycle counter */
-static unsigned cyc_hi = 0;
-static unsigned cyc_lo = 0;
+static unsigned long long cyc_start = 0;
+static int have_rdtscp = -1; /* does the CPU implement rdtscp? */
 
-
-/* Set *hi and *lo to the high and low order bits  of the cycle counter.  
-   Implementation requires assembly code to use the rdtsc instruction. */
-void access_counter(unsigned *hi, unsigned *lo)
+/*
+ * access_counter - Read the full 64-bit time stamp counter. rdtscp
+ *     does not execute until every earlier instruction has completed,
+ *     and the lfence after it keeps later instructions from starting
+ *     early, so the code being timed cannot leak out of either end of
+ *     the measurement. CPUs without rdtscp get lfence;rdtsc;lfence.
+ */
+static unsigned long long access_counter(void)
 {
-    asm("rdtsc; movl %%edx,%0; movl %%eax,%1"   /* Read cycle counter */
-	: "=r" (*hi), "=r" (*lo)                /* and move results to */
-	: /* No input */                        /* the two outputs */
-	: "%edx", "%eax");
+    unsigned hi, lo, aux;
+
+    if (have_rdtscp < 0) {
+	unsigned a, b, c, d;
+	have_rdtscp = __get_cpuid(0x80000001, &a, &b, &c, &d) &&
+	    (d & (1u << 27));
+    }
+    if (have_rdtscp)
+	asm volatile("rdtscp; lfence"
+		     : "=a" (lo), "=d" (hi), "=c" (aux) : : "memory");
+    else
+	asm volatile("lfence; rdtsc; lfence"
+		     : "=a" (lo), "=d" (hi) : : "memory");
+    return ((unsigned long long)hi << 32) | lo;
 }
 
 /* Record the current value of the cycle counter. */
 void start_counter()
 {
-    access_counter(&cyc_hi, &cyc_lo);
+    cyc_start = access_counter();
 }
 
 /* Return the number of cycles since the last call to start_counter. */
 double get_counter()
 {
-    unsigned ncyc_hi, ncyc_lo;
-    unsigned hi, lo, borrow;
-    double result;
+    return (double)(access_counter() - cyc_start);
+}
+/* $end x86cyclecounter */
 
-    /* Get cycle counter */
-    access_counter(&ncyc_hi, &ncyc_lo);
+/*
+ * tsc_invariant - Does the TSC tick at a constant rate regardless of
+ *     frequency scaling and sleep states (CPUID 0x80000007, EDX bit 8)?
+ *     Only then are TSC cycles a faithful measure of elapsed time.
+ */
+int tsc_invariant(void)
+{
+    unsigned a, b, c, d;
 
-    /* Do double precision subtraction */
-    lo = ncyc_lo - cyc_lo;
-    borrow = lo > ncyc_lo;
-    hi = ncyc_hi - cyc_hi - borrow;
-    result = (double) hi * (1 << 30) * 4 + lo;
-    if (result < 0) {
-	fprintf(stderr, "Error: counter returns neg value: %.0f\n", result);
-    }
-    return result;
+    if (!__get_cpuid(0x80000007, &a, &b, &c, &d))
+	return 0;
+    return (d & (1u << 8)) != 0;
+}
+
+/*
+ * tsc_mhz - Return the nominal TSC rate reported by the CPU: leaf 0x15
+ *     gives the TSC/crystal ratio and the crystal frequency, leaf 0x16
+ *     the base frequency. Returns 0 when the CPU (or the hypervisor)
+ *     does not say, in which case the caller has to calibrate.
+ */
+static double tsc_mhz(void)
+{
+    unsigned a, b, c, d;
+
+    if (__get_cpuid_count(0x15, 0, &a, &b, &c, &d) && a && b && c)
+	return (double)c * b / a / 1e6;
+    if (__get_cpuid_count(0x16, 0, &a, &b, &c, &d) && (a & 0xffff))
+	return (double)(a & 0xffff);
+    return 0;
 }
-/* $end x86cyclecounter */
 
 #elif defined(__alpha)
 
@@ -133,6 +165,11 @@ double get_counter()
     return result;
 }
 
+int tsc_invariant(void)
+{
+    return 0;
+}
+
 #else
 
 /****************************************************************
@@ -140,29 +177,58 @@ double get_counter()
  * counter routines. Newer models of sparcs (v8plus) have cycle
  * counters that can be accessed from user programs, but since there
  * are still many sparc boxes out there that don't support this, we
- * haven't provided a Sparc version here.
+ * count nanoseconds of CLOCK_MONOTONIC_RAW instead, and mhz() reports
+ * a 1000 MHz "clock" so that cycles convert back to seconds exactly.
  ***************************************************************/
 
+static struct timespec cyc_start;
+
 void start_counter()
 {
-    printf("ERROR: You are trying to use a start_counter routine in clock.c\n");
-    printf("that has not been implemented yet on this platform.\n");
-    printf("Please choose another timing package in config.h.\n");
-    exit(1);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &cyc_start);
 }
 
 double get_counter() 
 {
-    printf("ERROR: You are trying to use a get_counter routine in clock.c\n");
-    printf("that has not been implemented yet on this platform.\n");
-    printf("Please choose another timing package in config.h.\n");
-    exit(1);
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return (now.tv_sec - cyc_start.tv_sec) * 1e9 +
+	(now.tv_nsec - cyc_start.tv_nsec);
+}
+
+int tsc_invariant(void)
+{
+    return 0;
 }
 #endif
 
 
 
 
+/*
+ * read_cycles - Return the raw value of the cycle counter. Unlike
+ *     start_counter/get_counter, this keeps no state and does no
+ *     floating point, so it is cheap enough to bracket a single
+ *     malloc call. On machines without a user-readable cycle counter
+ *     it falls back to a nanosecond clock.
+ */
+unsigned long long read_cycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned hi, lo;
+
+    asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((unsigned long long)hi << 32) | lo;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+
 /*******************************
  * Machine-independent functions
  ******************************/
@@ -179,26 +245,76 @@ double ovhd()
     return result;
 }
 
+/*
+ * mono_secs - seconds on CLOCK_MONOTONIC_RAW, which is immune to NTP
+ *     slewing and so is the right reference for calibrating a counter
+ */
+static double mono_secs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 /* $begin mhz */
 /* Estimate the clock rate by measuring the cycles that elapse */ 
 /* while sleeping for sleeptime seconds */
 double mhz_full(int verbose, int sleeptime)
 {
-    double rate;
+    double rate, t;
 
+    t = mono_secs();
     start_counter();
     sleep(sleeptime);
-    rate = get_counter() / (1e6*sleeptime);
+    rate = get_counter();
+    t = mono_secs() - t;   /* sleep() may oversleep; use the real span */
+    rate /= 1e6 * t;
     if (verbose) 
 	printf("Processor clock rate ~= %.1f MHz\n", rate);
     return rate;
 }
 /* $end mhz */
 
-/* Version using a default sleeptime */
+/*
+ * calibrate_mhz - Estimate the counter rate by spinning for secs
+ *     seconds against CLOCK_MONOTONIC_RAW. Much shorter than sleeping
+ *     and just as accurate, since both ends are read back to back.
+ */
+static double calibrate_mhz(double secs)
+{
+    double t0, t;
+
+    t0 = mono_secs();
+    start_counter();
+    do
+	t = mono_secs();
+    while (t - t0 < secs);
+    return get_counter() / (1e6 * (t - t0));
+}
+
+/*
+ * mhz - Determine the counter rate. With an invariant TSC that
+ *     reports its own frequency nothing needs to be measured; otherwise
+ *     calibrate for a tenth of a second.
+ */
 double mhz(int verbose)
 {
-    return mhz_full(verbose, 2);
+    double rate = 0;
+
+#if defined(__i386__) || defined(__x86_64__)
+    if (tsc_invariant())
+	rate = tsc_mhz();
+    else if (verbose)
+	printf("Warning: TSC is not invariant, cycle counts may drift\n");
+#elif !defined(__alpha)
+    rate = 1000.0;         /* the counter is CLOCK_MONOTONIC_RAW in ns */
+#endif
+    if (rate == 0)
+	rate = calibrate_mhz(0.1);
+    if (verbose) 
+	printf("Processor clock rate ~= %.1f MHz\n", rate);
+    return rate;
 }
 
 /** Special counters that compensate for timer interrupt overhead */
@@ -270,6 +386,8 @@ double get_comp_counter()
     times(&t);
     ticks = t.tms_utime - start_tick;
     ctime = time - ticks*cyc_per_tick;
+    if (ctime <= 0)     /* a short run that merely straddled a tick */
+	ctime = time;
     /*
       printf("Measured %.0f cycles.  Ticks = %d.  Corrected %.0f cycles\n",
       time, (int) ticks, ctime);
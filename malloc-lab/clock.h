@@ -6,10 +6,16 @@ void start_counter();
 /* Get # cycles since counter started */
 double get_counter();
 
+/* Read the raw cycle counter (cheap, for timing single operations) */
+unsigned long long read_cycles(void);
+
 /* Measure overhead for counter */
 double ovhd();
 
-/* Determine clock rate of processor (using a default sleeptime) */
+/* Does the cycle counter run at a constant rate (invariant TSC)? */
+int tsc_invariant(void);
+
+/* Determine clock rate of processor (CPUID or a short calibration) */
 double mhz(int verbose);
 
 /* Determine clock rate of processor, having more control over accuracy */
@@ -65,8 +65,9 @@
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
  *****************************************************************************/
-#define USE_FCYC   0   /* cycle counter w/K-best scheme (x86 & Alpha only) */
-#define USE_ITIMER 0   /* interval timer (any Unix box) */
-#define USE_GETTOD 1   /* gettimeofday (any Unix box) */
+#define USE_FCYC      1 /* cycle counter w/K-best scheme (TSC on x86, else ns) */
+#define USE_ITIMER    0 /* interval timer (any Unix box) */
+#define USE_GETTOD    0 /* gettimeofday (any Unix box) */
+#define USE_MONOTONIC 0 /* clock_gettime(CLOCK_MONOTONIC_RAW) (POSIX) */
 
 #endif /* __CONFIG_H */
@@ -0,0 +1,117 @@
+/*
+ * copybench.c - compare memcopy with libc memcpy across copy sizes
+ *
+ * For sizes from 256 bytes up to -m bytes, in steps of 4x, times a
+ * single copy with fcyc and prints the throughput in bytes per cycle
+ * of libc memcpy and of every memcopy implementation this CPU can run,
+ * once with ordinary stores and once with non-temporal stores. The
+ * crossover between the two is the place to put the non-temporal
+ * threshold. The buffers are 8 bytes off a cache line, like the
+ * payloads mm.c hands out.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fcyc.h"
+#include "memcopy.h"
+
+/* One timed copy */
+typedef struct {
+    char *dst;
+    char *src;
+    size_t n;
+} copy_t;
+
+static void run_libc(void *arg)
+{
+    copy_t *c = (copy_t *)arg;
+
+    memcpy(c->dst, c->src, c->n);
+}
+
+static void run_memcopy(void *arg)
+{
+    copy_t *c = (copy_t *)arg;
+
+    memcopy(c->dst, c->src, c->n);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: copybench [-c <bytes>] [-m <bytes>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-c <bytes>  Flush this much cache before each copy (cold copies).\n");
+    fprintf(stderr, "\t-m <bytes>  Largest copy (default 67108864).\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    static const char *names[] = {"sse2", "avx2", "avx512", NULL};
+    size_t max = 64 << 20, n, nt;
+    char *dst, *src;
+    copy_t c;
+    int i, flush = 0, opt;
+
+    while ((opt = getopt(argc, argv, "c:m:h")) != EOF) {
+	switch (opt) {
+	case 'c': flush = atoi(optarg); break;
+	case 'm': max = (size_t)strtoull(optarg, NULL, 10); break;
+	default: usage();
+	}
+    }
+    if (max < 256)
+	usage();
+
+    if ((dst = (char *)malloc(max + 128)) == NULL ||
+	(src = (char *)malloc(max + 128)) == NULL) {
+	fprintf(stderr, "copybench: out of memory\n");
+	exit(1);
+    }
+    /* Fault the pages in now, not inside the first copy */
+    memset(dst, 0, max + 128);
+    memset(src, 1, max + 128);
+    c.dst = (char *)(((size_t)dst + 63) & ~(size_t)63) + 8;
+    c.src = (char *)(((size_t)src + 63) & ~(size_t)63) + 8;
+
+    set_fcyc_k(3);
+    set_fcyc_epsilon(0.01);
+    set_fcyc_maxsamples(50);
+    set_fcyc_compensate(0);
+    if (flush > 0) {
+	set_fcyc_cache_size(flush);
+	set_fcyc_cache_block(64);
+	set_fcyc_clear_cache(1);
+    }
+
+    nt = memcopy_nt();
+    printf("memcopy uses %s, non-temporal from %lu bytes%s\n",
+	   memcopy_impl(), (unsigned long)nt, flush ? ", cold caches" : "");
+    printf("Throughput in bytes/cycle (\"nt\": non-temporal stores)\n");
+    printf("%10s %8s", "bytes", "libc");
+    for (i = 0; names[i] != NULL; i++)
+	if (memcopy_select(names[i]) == 0)
+	    printf(" %8s %7s-nt", names[i], names[i]);
+    printf("\n");
+
+    for (n = 256; n <= max; n *= 4) {
+	c.n = n;
+	printf("%10lu %8.2f", (unsigned long)n, n / fcyc(run_libc, &c));
+	for (i = 0; names[i] != NULL; i++) {
+	    if (memcopy_select(names[i]) < 0)
+		continue;
+	    memcopy_set_nt((size_t)-1);
+	    printf(" %8.2f", n / fcyc(run_memcopy, &c));
+	    memcopy_set_nt(0);
+	    printf(" %10.2f", n / fcyc(run_memcopy, &c));
+	}
+	printf("\n");
+	fflush(stdout);
+    }
+    memcopy_set_nt(nt);
+    free(dst);
+    free(src);
+    return 0;
+}
@@ -10,8 +10,25 @@
 
 static double Mhz;  /* estimated CPU clock frequency */
 
+/* K-best parameters, see set_fsecs_kbest() */
+static int kbest = 3;
+static double epsilon = 0.01;
+static int maxsamples = 20;
+
 extern int verbose; /* -v option in mdriver.c */
 
+/*
+ * set_fsecs_kbest - choose the K-best parameters used by the cycle
+ *    counter timer: stop once the K fastest of at most maxsamples runs
+ *    agree within a factor of 1+epsilon. Call before init_fsecs().
+ */
+void set_fsecs_kbest(int k, double epsilon_arg, int maxsamples_arg)
+{
+    kbest = k;
+    epsilon = epsilon_arg;
+    maxsamples = maxsamples_arg;
+}
+
 /*
  * init_fsecs - initialize the timing package
  */
@@ -24,18 +41,35 @@ void init_fsecs(void)
 	printf("Measuring performance with a cycle counter.\n");
 
     /* set key parameters for the fcyc package */
-    set_fcyc_maxsamples(20); 
+    set_fcyc_maxsamples(maxsamples); 
     set_fcyc_clear_cache(1);
-    set_fcyc_compensate(1);
-    set_fcyc_epsilon(0.01);
-    set_fcyc_k(3);
+    /* An invariant TSC counts elapsed time at a fixed rate, so there
+       are no timer interrupts to take out, and taking a whole tick out
+       of a run shorter than one makes it negative */
+    set_fcyc_compensate(!tsc_invariant());
+    set_fcyc_epsilon(epsilon);
+    set_fcyc_k(kbest);
     Mhz = mhz(verbose > 0);
+
+    /* Calibrate the timer interrupt compensation up front (it takes a
+       few seconds), so that it is done once and inherited by -j workers
+       instead of landing inside the first measurement of each one */
+    if (!tsc_invariant()) {
+	start_comp_counter();
+	get_comp_counter();
+    }
+    if (verbose)
+	printf("K-best: K=%d, epsilon=%g, at most %d samples\n",
+	       kbest, epsilon, maxsamples);
 #elif USE_ITIMER
     if (verbose)
 	printf("Measuring performance with the interval timer.\n");
 #elif USE_GETTOD
     if (verbose)
 	printf("Measuring performance with gettimeofday().\n");
+#elif USE_MONOTONIC
+    if (verbose)
+	printf("Measuring performance with clock_gettime().\n");
 #endif
 }
 
@@ -51,6 +85,8 @@ double fsecs(fsecs_test_funct f, void *argp)
     return ftimer_itimer(f, argp, 10);
 #elif USE_GETTOD
     return ftimer_gettod(f, argp, 10);
+#elif USE_MONOTONIC
+    return ftimer_monotonic(f, argp, 10);
 #endif 
 }
 
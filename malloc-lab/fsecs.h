@@ -1,4 +1,5 @@
 typedef void (*fsecs_test_funct)(void *);
 
 void init_fsecs(void);
+void set_fsecs_kbest(int k, double epsilon, int maxsamples);
 double fsecs(fsecs_test_funct f, void *argp);
@@ -0,0 +1,268 @@
+/*
+ * heapprof.c - stack walking, sample tables and profile output
+ *
+ * Live samples hang off a chained table indexed like heapprof_filter,
+ * so the filter count of a slot is the length of its chain. Samples
+ * with the same stack share a bucket, which keeps the counts. Both are
+ * cut from chunks mapped from the OS and kept across heapprof_start,
+ * as pagemap.c does with span descriptors, and freed samples are
+ * recycled through a free list.
+ */
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "heapprof.h"
+
+#define NBUCKETS (1 << 10)       /* hash chains of buckets */
+#define POOL_CHUNK (64 * 1024)   /* bytes mapped at a time */
+#define FRAME_MAX (1 << 20)      /* no stack frame is bigger */
+
+/* Top of the main thread's stack, where a frame walk must stop */
+extern void *__libc_stack_end;
+
+/* The samples taken with one stack */
+typedef struct bucket {
+    struct bucket *next;         /* hash chain */
+    unsigned long hash;
+    int depth;
+    size_t allocs, alloc_bytes;  /* samples taken */
+    size_t frees, free_bytes;    /* those of them freed since */
+    void *stack[HP_DEPTH];       /* return addresses, innermost first */
+} bucket_t;
+
+/* A sampled object that is still allocated */
+typedef struct sample {
+    struct sample *next;         /* chain of its slot, or the free list */
+    void *ptr;
+    size_t size;
+    bucket_t *bucket;
+} sample_t;
+
+long heapprof_left = LONG_MAX;
+unsigned short heapprof_filter[1 << HP_FILTER_BITS];
+
+static size_t rate;                          /* mean bytes between samples */
+static unsigned long long rng = 88172645463325252ULL;
+static bucket_t *buckets[NBUCKETS];
+static sample_t *live[1 << HP_FILTER_BITS];
+static size_t nlive;
+static sample_t *sample_freelist;
+
+/* Chunks are chained through their first word */
+static char *pool_first;         /* first chunk mapped */
+static char *pool_chunk;         /* chunk being cut */
+static size_t pool_used;         /* bytes of it handed out */
+
+/*
+ * pool_alloc - n zeroed bytes from the current chunk, moving on to the
+ *     next one, mapped if need be, when it is used up; NULL on failure
+ */
+static void *pool_alloc(size_t n)
+{
+    char *next, *p;
+
+    if (pool_chunk == NULL || pool_used + n > POOL_CHUNK) {
+        next = pool_chunk ? *(char **)pool_chunk : pool_first;
+        if (next == NULL) {
+            next = mmap(NULL, POOL_CHUNK, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (next == MAP_FAILED)
+                return NULL;
+            if (pool_chunk != NULL)
+                *(char **)pool_chunk = next;
+            else
+                pool_first = next;
+        }
+        pool_chunk = next;
+        pool_used = sizeof(char *);
+    }
+    p = pool_chunk + pool_used;
+    pool_used += n;
+    memset(p, 0, n);
+    return p;
+}
+
+/*
+ * next_gap - Bytes to the next sample, exponentially distributed with
+ *     mean rate (xorshift64* for the uniform draw)
+ */
+static long next_gap(void)
+{
+    double u;
+
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    u = (double)(((rng * 2685821657736338717ULL) >> 11) + 1) / 9007199254740992.0;
+    return (long)(-log(u) * rate);
+}
+
+/*
+ * heapprof_start - Drop all samples and buckets and sample every rate
+ *     bytes from now on; never if rate is 0
+ */
+void heapprof_start(size_t r)
+{
+    memset(buckets, 0, sizeof(buckets));
+    memset(live, 0, sizeof(live));
+    memset(heapprof_filter, 0, sizeof(heapprof_filter));
+    nlive = 0;
+    sample_freelist = NULL;
+    pool_chunk = NULL;
+    rate = r;
+    heapprof_left = rate ? next_gap() : LONG_MAX;
+}
+
+/*
+ * forget - Count the object of sample s, already off the live table, as
+ *     freed, and recycle s
+ */
+static void forget(sample_t *s)
+{
+    s->bucket->frees++;
+    s->bucket->free_bytes += s->size;
+    s->next = sample_freelist;
+    sample_freelist = s;
+    nlive--;
+}
+
+/*
+ * heapprof_reset - Count every live sample as freed
+ */
+void heapprof_reset(void)
+{
+    sample_t *s, *next;
+    int i;
+
+    if (nlive == 0)
+        return;
+    for (i = 0; i < (1 << HP_FILTER_BITS); i++) {
+        for (s = live[i]; s != NULL; s = next) {
+            next = s->next;
+            forget(s);
+        }
+        live[i] = NULL;
+        heapprof_filter[i] = 0;
+    }
+}
+
+/*
+ * heapprof_sample - Walk the frame pointers up from here to the top of
+ *     the stack and record p under the bucket of the return addresses
+ *     found. The walk stops at the first frame pointer that does not
+ *     lead further up the stack.
+ */
+void heapprof_sample(void *p, size_t size)
+{
+    void *stack[HP_DEPTH];
+    void **fp = __builtin_frame_address(0), **up;
+    unsigned long h = 0;
+    unsigned slot;
+    int depth = 0;
+    bucket_t *b;
+    sample_t *s;
+
+    if (rate == 0) {
+        heapprof_left = LONG_MAX;
+        return;
+    }
+    heapprof_left = next_gap();
+
+    while (depth < HP_DEPTH && fp[1] != NULL) {
+        stack[depth++] = fp[1];
+        up = fp[0];
+        if (up <= fp || (char *)up >= (char *)__libc_stack_end ||
+            (char *)up - (char *)fp > FRAME_MAX)
+            break;
+        fp = up;
+    }
+    for (slot = 0; slot < (unsigned)depth; slot++)
+        h = (h + (unsigned long)stack[slot]) * 0x9E3779B97F4A7C15UL;
+
+    for (b = buckets[h % NBUCKETS]; b != NULL; b = b->next)
+        if (b->hash == h && b->depth == depth &&
+            memcmp(b->stack, stack, depth * sizeof(void *)) == 0)
+            break;
+    if (b == NULL) {
+        if ((b = pool_alloc(sizeof(bucket_t))) == NULL)
+            return;
+        b->hash = h;
+        b->depth = depth;
+        memcpy(b->stack, stack, depth * sizeof(void *));
+        b->next = buckets[h % NBUCKETS];
+        buckets[h % NBUCKETS] = b;
+    }
+
+    if ((s = sample_freelist) != NULL)
+        sample_freelist = s->next;
+    else if ((s = pool_alloc(sizeof(sample_t))) == NULL)
+        return;
+    b->allocs++;
+    b->alloc_bytes += size;
+    s->ptr = p;
+    s->size = size;
+    s->bucket = b;
+    slot = HP_SLOT(p);
+    s->next = live[slot];
+    live[slot] = s;
+    heapprof_filter[slot]++;
+    nlive++;
+}
+
+/*
+ * heapprof_free - Forget the sample of p, if it has one
+ */
+void heapprof_free(void *p)
+{
+    unsigned slot = HP_SLOT(p);
+    sample_t **link, *s;
+
+    for (link = &live[slot]; (s = *link) != NULL; link = &s->next)
+        if (s->ptr == p) {
+            *link = s->next;
+            heapprof_filter[slot]--;
+            forget(s);
+            return;
+        }
+}
+
+/*
+ * heapprof_dump - Write the profile, in the format of the heap profiles
+ *     of gperftools, which pprof reads: a header with the totals and the
+ *     sampling rate, a line per bucket, and /proc/self/maps
+ */
+int heapprof_dump(FILE *f)
+{
+    size_t inuse = 0, inuse_bytes = 0, allocs = 0, alloc_bytes = 0, n;
+    char buf[4096];
+    bucket_t *b;
+    FILE *maps;
+    int i, k;
+
+    for (i = 0; i < NBUCKETS; i++)
+        for (b = buckets[i]; b != NULL; b = b->next) {
+            inuse += b->allocs - b->frees;
+            inuse_bytes += b->alloc_bytes - b->free_bytes;
+            allocs += b->allocs;
+            alloc_bytes += b->alloc_bytes;
+        }
+    fprintf(f, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+            inuse, inuse_bytes, allocs, alloc_bytes, rate);
+    for (i = 0; i < NBUCKETS; i++)
+        for (b = buckets[i]; b != NULL; b = b->next) {
+            fprintf(f, "%zu: %zu [%zu: %zu] @", b->allocs - b->frees,
+                    b->alloc_bytes - b->free_bytes, b->allocs, b->alloc_bytes);
+            for (k = 0; k < b->depth; k++)
+                fprintf(f, " %p", b->stack[k]);
+            fputc('\n', f);
+        }
+
+    fprintf(f, "\nMAPPED_LIBRARIES:\n");
+    if ((maps = fopen("/proc/self/maps", "r")) != NULL) {
+        while ((n = fread(buf, 1, sizeof(buf), maps)) > 0)
+            fwrite(buf, 1, n, f);
+        fclose(maps);
+    }
+    return ferror(f) ? -1 : 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * heapprof.h - sampling heap profiler
+ *
+ * About once every rate bytes allocated, the allocator records the
+ * call stack of an allocation, found by following frame pointers, with
+ * its size. Samples are counted per distinct stack and stay live until
+ * their object is freed, so a profile shows both where memory was
+ * allocated and where the memory still in use came from. The distance
+ * to the next sample is drawn from an exponential distribution: every
+ * byte is equally likely to be sampled, and an allocation pattern
+ * cannot fall into step with the sampling.
+ *
+ * The allocator pays one subtraction per allocation and one load per
+ * free. heapprof_left counts down the bytes to the next sample, and
+ * heapprof_filter holds the number of live samples whose address hashes
+ * to each slot, so a free looks for a sample only if one may be there.
+ *
+ * Stacks are only walked through code built with frame pointers
+ * (-fno-omit-frame-pointer). Profiler memory is mapped directly from
+ * the OS and not counted in the heap.
+ */
+#ifndef __HEAPPROF_H_
+#define __HEAPPROF_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define HP_DEPTH 32              /* frames kept per stack */
+#define HP_FILTER_BITS 12
+
+extern long heapprof_left;
+extern unsigned short heapprof_filter[1 << HP_FILTER_BITS];
+
+/* Filter slot of address p, also its chain in the table of live samples */
+#define HP_SLOT(p) \
+    ((unsigned)(((unsigned long long)(size_t)(p) * 0x9E3779B97F4A7C15ULL) >> \
+                (64 - HP_FILTER_BITS)))
+
+/*
+ * Start a new profile, sampling once every rate bytes on average, or
+ * stop profiling if rate is 0. Everything sampled before is dropped.
+ */
+void heapprof_start(size_t rate);
+
+/* The heap was started over: count every live sample as freed */
+void heapprof_reset(void);
+
+/*
+ * Record object p of size bytes and its caller's stack, and draw the
+ * distance to the next sample. Called when heapprof_left drops below 0.
+ */
+void heapprof_sample(void *p, size_t size);
+
+/* Object p is being freed; forget its sample if it has one */
+void heapprof_free(void *p);
+
+/*
+ * Write the profile to f in the legacy text format of pprof: per stack,
+ * the live samples and their bytes, then every sample taken and its
+ * bytes, and then the address map of the process for symbolization.
+ * Returns 0, or -1 on a write error.
+ */
+int heapprof_dump(FILE *f);
+
+#endif /* __HEAPPROF_H_ */
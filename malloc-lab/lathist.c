@@ -0,0 +1,92 @@
+/*
+ * lathist.c - log-bucketed latency histograms
+ *
+ * Recording is a count-leading-zeros, a shift and an increment, so a
+ * histogram can sit in the inner loop of a trace replay without
+ * dominating the operations it measures.
+ */
+#include <string.h>
+#include "lathist.h"
+
+/*
+ * bin_of - map a value to its bucket index
+ */
+static int bin_of(unsigned long long val)
+{
+    int e;
+
+    if (val < LATHIST_SUBCOUNT)
+	return (int)val;
+    e = 63 - __builtin_clzll(val);      /* e >= LATHIST_SUBBITS */
+    return ((e - LATHIST_SUBBITS + 1) << LATHIST_SUBBITS) |
+	(int)((val >> (e - LATHIST_SUBBITS)) & (LATHIST_SUBCOUNT - 1));
+}
+
+/*
+ * bin_high - return the largest value that maps to bucket i
+ */
+static unsigned long long bin_high(int i)
+{
+    int g = i >> LATHIST_SUBBITS;
+    unsigned long long m = i & (LATHIST_SUBCOUNT - 1);
+
+    if (g == 0)
+	return m;
+    return (((LATHIST_SUBCOUNT | m) + 1) << (g - 1)) - 1;
+}
+
+/*
+ * lathist_reset - Empty a histogram
+ */
+void lathist_reset(lathist_t *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = ~0ULL;
+}
+
+/*
+ * lathist_add - Record one value
+ */
+void lathist_add(lathist_t *h, unsigned long long val)
+{
+    h->bins[bin_of(val)]++;
+    h->count++;
+    h->sum += (double)val;
+    if (val < h->min)
+	h->min = val;
+    if (val > h->max)
+	h->max = val;
+}
+
+/*
+ * lathist_percentile - Return the value at percentile pct. Like HDR
+ *     histograms we report the highest value equivalent to the bucket
+ *     the percentile falls in, clamped to the true maximum.
+ */
+unsigned long long lathist_percentile(const lathist_t *h, double pct)
+{
+    unsigned long long rank, seen = 0;
+    int i;
+
+    if (h->count == 0)
+	return 0;
+    rank = (unsigned long long)(pct / 100.0 * h->count + 0.5);
+    if (rank < 1)
+	rank = 1;
+    if (rank > h->count)
+	rank = h->count;
+    for (i = 0; i < LATHIST_NBINS; i++) {
+	seen += h->bins[i];
+	if (seen >= rank)
+	    return bin_high(i) < h->max ? bin_high(i) : h->max;
+    }
+    return h->max;
+}
+
+/*
+ * lathist_mean - Return the mean of the recorded values
+ */
+double lathist_mean(const lathist_t *h)
+{
+    return h->count ? h->sum / h->count : 0.0;
+}
@@ -0,0 +1,36 @@
+/*
+ * lathist.h - log-bucketed latency histograms (HDR-style)
+ *
+ * Values below 2^LATHIST_SUBBITS get a bucket of their own. Above
+ * that, every power of two is split into 2^LATHIST_SUBBITS equal
+ * sub-buckets, so the relative error of a reported percentile is
+ * bounded by 2^-LATHIST_SUBBITS (about 3%) over the full 64-bit range.
+ */
+#ifndef __LATHIST_H_
+#define __LATHIST_H_
+
+#define LATHIST_SUBBITS 5
+#define LATHIST_SUBCOUNT (1 << LATHIST_SUBBITS)
+#define LATHIST_NBINS ((64 - LATHIST_SUBBITS + 1) << LATHIST_SUBBITS)
+
+typedef struct {
+    unsigned long long count;              /* number of recorded values */
+    unsigned long long min;                /* smallest recorded value */
+    unsigned long long max;                /* largest recorded value */
+    double sum;                            /* sum of recorded values */
+    unsigned long long bins[LATHIST_NBINS];
+} lathist_t;
+
+/* Empty a histogram */
+void lathist_reset(lathist_t *h);
+
+/* Record one value */
+void lathist_add(lathist_t *h, unsigned long long val);
+
+/* Return the value at percentile pct (0 < pct <= 100) */
+unsigned long long lathist_percentile(const lathist_t *h, double pct);
+
+/* Return the mean of the recorded values */
+double lathist_mean(const lathist_t *h);
+
+#endif /* __LATHIST_H_ */
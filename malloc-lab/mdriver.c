@@ -7,6 +7,7 @@
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
  */
+#define _GNU_SOURCE /* for sched_setaffinity() */
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -14,13 +15,21 @@
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <math.h>
 #include <time.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 extern char *optarg; // Added declaration for optarg
 
 #include "mm.h"
 #include "memlib.h"
 #include "fsecs.h"
+#include "clock.h"
+#include "lathist.h"
+#include "perfctr.h"
+#include "traces/tracefile.h"
 #include "config.h"
 
 /**********************
@@ -31,10 +40,20 @@ extern char *optarg; // Added declaration for optarg
 #define MAXLINE 1024	   /* max string size */
 #define HDRLINES 4		   /* number of header lines in a trace file */
 #define LINENUM(i) (i + 5) /* cnvt trace request nums to linenums (origin 1) */
+#define NUM_OPTYPES 7	   /* number of request types in traceop_t */
+#define LATRUNS 10		   /* number of instrumented replays per trace (-L) */
+#define PMCRUNS 10		   /* number of counted replays per trace (-P) */
+#define MAXRUNS 100		   /* max number of repeated timings per trace (-r) */
+#define LONG_LIVED 0.1	   /* part of a trace a long-lived block outlives (-H) */
+#define FRAG_CLASSES 12	   /* free bytes by block size: <32, <64, ..., >=32K */
+#define REGRESS_MIN 0.02   /* ignore slowdowns smaller than 2% (-b) */
 
 /* Returns true if p is ALIGNMENT-byte aligned */
 #define IS_ALIGNED(p) ((((unsigned int)(p)) % ALIGNMENT) == 0)
 
+/* posix_memalign wants at least pointer alignment */
+#define LIBC_ALIGN(a) ((a) < (int)sizeof(void *) ? (int)sizeof(void *) : (a))
+
 /******************************
  * The key compound data types
  *****************************/
@@ -54,10 +73,18 @@ typedef struct
 	{
 		ALLOC,
 		FREE,
-		REALLOC
+		REALLOC,
+		CALLOC,
+		MEMALIGN,
+		ALLOC_BATCH,
+		FREE_BATCH
 	} type;	   /* type of request */
-	int index; /* index for free() to use later */
-	int size;  /* byte size of alloc/realloc request */
+	int index; /* index for free() to use later, the first of a batch */
+	int size;  /* byte size of alloc/realloc/calloc/memalign request,
+				  and of the block a free releases */
+	int align; /* alignment of a memalign request */
+	int count; /* number of ids in a batch request */
+	int hint;  /* lifetime hint of an alloc request (-H) */
 } traceop_t;
 
 /* Holds the information for one trace file*/
@@ -83,16 +110,46 @@ typedef struct
 	range_t *ranges;
 } speed_t;
 
+/* Tail latency of one request type on one trace, in cycles (-L) */
+typedef struct
+{
+	double count; /* number of timed requests */
+	double p50;	  /* median */
+	double p99;
+	double p999;
+	double max;
+} latsum_t;
+
+/* The state of the heap at one point in a fragmentation timeline (-F) */
+typedef struct
+{
+	double alloc_bytes;				   /* bytes in allocated blocks */
+	double free_bytes;				   /* bytes in free blocks */
+	double free_blocks;				   /* number of free blocks */
+	double largest_free;			   /* size of the largest free block */
+	double tail_free;				   /* free bytes at the end of the heap */
+	double free_class[FRAG_CLASSES]; /* free bytes by block size class */
+} heapscan_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct
 {
 	/* defined for both libc malloc and student malloc package (mm.c) */
 	double ops;	 /* number of ops (malloc/free/realloc) in the trace */
 	int valid;	 /* was the trace processed correctly by the allocator? */
-	double secs; /* number of secs needed to run the trace */
+	double secs; /* number of secs needed to run the trace (mean of runs) */
+	double secs_sd; /* standard deviation of secs over the runs */
+	int runs;		/* number of independent timings of the trace (-r) */
 
 	/* defined only for the student malloc package */
 	double util; /* space utilization for this trace (always 0 for libc) */
+	double heap; /* peak heap size in bytes (always 0 for libc) */
+
+	/* defined only when latency replay (-L) is enabled */
+	latsum_t lat[NUM_OPTYPES]; /* indexed by request type */
+
+	/* defined only when perf counters (-P) are enabled */
+	double pmc[PERFCTR_NEVENTS]; /* event counts per replay, -1 if n/a */
 
 	/* Note: secs and util are only defined if valid is true */
 } stats_t;
@@ -104,6 +161,17 @@ int verbose = 0;	   /* global flag for verbose output */
 static int errors = 0; /* number of errs found when running student malloc */
 char msg[MAXLINE];	   /* for whenever we need to compose an error message */
 
+/* Evaluation options shared by the serial and parallel (-j) paths */
+static int latency = 0;	 /* if set, replay traces with per-op timing (-L) */
+static int counters = 0; /* if set, count hardware perf events (-P) */
+static int runs = 1;	 /* independent timings per trace (-r) */
+static int jobs = 1;	 /* number of traces evaluated at once (-j) */
+static int frag_interval = 0; /* sample the heap every this many ops (-F) */
+static int sized_free = 0; /* if set, free through mm_free_sized (-S) */
+static int hints = 0;	   /* if set, pass predicted lifetimes (-H) */
+static long prof_rate = 0; /* sample an allocation every this many bytes (-p) */
+static int check_interval = 0; /* check the heap in full every this many ops (-c) */
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
@@ -124,6 +192,7 @@ static void clear_ranges(range_t **ranges);
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(char *tracedir, char *filename);
 static void free_trace(trace_t *trace);
+static void predict_lifetimes(trace_t *trace);
 
 /* Routines for evaluating the correctness and speed of libc malloc */
 static int eval_libc_valid(trace_t *trace, int tracenum);
@@ -132,11 +201,30 @@ static void eval_libc_speed(void *ptr);
 /* Routines for evaluating correctnes, space utilization, and speed
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
+static int check_posix_memalign(int tracenum);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
+static void eval_mm_latency(trace_t *trace, latsum_t *lat);
+static void eval_mm_frag(trace_t *trace, char *filename);
+static void write_profile(char *filename);
+static void eval_mm_counters(speed_t *speed_params, double *pmc);
+static void eval_mm_trace(char *filename, int tracenum, stats_t *stats);
+static void eval_mm_parallel(char **tracefiles, int n, stats_t *stats);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printlatency(int n, stats_t *stats);
+static void printcounters(int n, stats_t *stats);
+static double time_trace(fsecs_test_funct f, speed_t *speed_params,
+						 int runs, stats_t *stats);
+
+/* These functions write results out and compare them with a baseline */
+static void write_csv(char *filename, char **tracefiles, int n,
+					  stats_t *stats, int latency);
+static void write_json(char *filename, char **tracefiles, int n,
+					   stats_t *stats, int latency, double perfindex);
+static int compare_baseline(char *filename, char **tracefiles, int n,
+							stats_t *stats);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -152,14 +240,20 @@ int main(int argc, char **argv)
 	char **tracefiles = NULL;	/* null-terminated array of trace file names */
 	int num_tracefiles = 0;		/* the number of traces in that array */
 	trace_t *trace = NULL;		/* stores a single trace file in memory */
-	range_t *ranges = NULL;		/* keeps track of block extents for one trace */
 	stats_t *libc_stats = NULL; /* libc stats for each trace */
-	stats_t *mm_stats = NULL;	/* mm (i.e. student) stats for each trace */
+	stats_t *mm_results = NULL;	/* mm (i.e. student) stats for each trace */
 	speed_t speed_params;		/* input parameters to the xx_speed routines */
 
 	int team_check = 1; /* If set, check team structure (reset by -a) */
 	int run_libc = 0;	/* If set, run libc malloc (set by -l) */
 	int autograder = 0; /* If set, emit summary info for autograder (-g) */
+	int kbest = 3;		/* K-best sampler: K (-k), ... */
+	double epsilon = 0.01; /* ... tolerance (-e), ... */
+	int maxsamples = 20;	/* ... and sample limit (-s) */
+	char *csvfile = NULL;	/* write results as CSV here (-C) */
+	char *jsonfile = NULL;	/* write results as JSON here (-J) */
+	char *basefile = NULL;	/* compare against this CSV baseline (-b) */
+	int regressions = 0;	/* number of traces that got worse than -b */
 
 	/* temporaries used to compute the performance index */
 	double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -168,7 +262,7 @@ int main(int argc, char **argv)
 	/*
 	 * Read and interpret the command line arguments
 	 */
-	while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF)
+	while ((c = getopt(argc, argv, "f:t:k:e:s:r:C:J:b:j:F:D:p:c:hvVgalLPSH")) != EOF)
 	{
 		printf("getopt returned: %d\n", c); // 디버깅용 출력 추가
 
@@ -192,12 +286,85 @@ int main(int argc, char **argv)
 			if (tracedir[strlen(tracedir) - 1] != '/')
 				strcat(tracedir, "/"); /* path always ends with "/" */
 			break;
+		case 'k': /* K in the K-best timing scheme */
+			kbest = atoi(optarg);
+			break;
+		case 'e': /* K-best convergence tolerance */
+			epsilon = atof(optarg);
+			break;
+		case 's': /* Give up on K-best convergence after this many runs */
+			maxsamples = atoi(optarg);
+			break;
+		case 'r': /* Time each trace this many times */
+			runs = atoi(optarg);
+			if (runs < 1 || runs > MAXRUNS)
+			{
+				fprintf(stderr, "ERROR: -r must be between 1 and %d\n", MAXRUNS);
+				exit(1);
+			}
+			break;
+		case 'j': /* Evaluate this many traces in parallel */
+			jobs = atoi(optarg);
+			if (jobs < 1)
+			{
+				fprintf(stderr, "ERROR: -j needs a positive number of jobs\n");
+				exit(1);
+			}
+			break;
+		case 'F': /* Write a fragmentation timeline for each trace */
+			frag_interval = atoi(optarg);
+			if (frag_interval < 1)
+			{
+				fprintf(stderr, "ERROR: -F needs a positive sampling interval\n");
+				exit(1);
+			}
+			break;
+		case 'p': /* Write a sampled heap profile for each trace */
+			prof_rate = atol(optarg);
+			if (prof_rate < 1)
+			{
+				fprintf(stderr, "ERROR: -p needs a positive sampling rate\n");
+				exit(1);
+			}
+			break;
+		case 'c': /* Check the heap after every op */
+			check_interval = atoi(optarg);
+			if (check_interval < 1)
+			{
+				fprintf(stderr, "ERROR: -c needs a positive interval\n");
+				exit(1);
+			}
+			break;
+		case 'D': /* Purge free pages after this many idle ops */
+			mm_set_decay(atol(optarg));
+			break;
+		case 'C': /* Write results as CSV */
+			csvfile = optarg;
+			break;
+		case 'J': /* Write results as JSON */
+			jsonfile = optarg;
+			break;
+		case 'b': /* Compare with a baseline written by -C */
+			basefile = optarg;
+			break;
 		case 'a': /* Don't check team structure */
 			team_check = 0;
 			break;
 		case 'l': /* Run libc malloc */
 			run_libc = 1;
 			break;
+		case 'L': /* Report per-op latency percentiles */
+			latency = 1;
+			break;
+		case 'P': /* Report hardware performance counters */
+			counters = 1;
+			break;
+		case 'H': /* Pass predicted lifetimes to mm_malloc_hint */
+			hints = 1;
+			break;
+		case 'S': /* Free through mm_free_sized */
+			sized_free = 1;
+			break;
 		case 'v': /* Print per-trace performance breakdown */
 			verbose = 1;
 			break;
@@ -256,8 +423,18 @@ int main(int argc, char **argv)
 	}
 
 	/* Initialize the timing package */
+	if (kbest < 1 || maxsamples < kbest || epsilon < 0)
+	{
+		fprintf(stderr, "ERROR: need 1 <= K <= max samples and epsilon >= 0\n");
+		exit(1);
+	}
+	set_fsecs_kbest(kbest, epsilon, maxsamples);
 	init_fsecs();
 
+	/* Open the hardware counters, if we can */
+	if (counters && perfctr_init() == 0)
+		printf("Hardware performance counters are not available.\n");
+
 	/*
 	 * Optionally run and evaluate the libc malloc package
 	 */
@@ -284,7 +461,7 @@ int main(int argc, char **argv)
 				speed_params.trace = trace;
 				if (verbose > 1)
 					printf("and performance.\n");
-				libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+				time_trace(eval_libc_speed, &speed_params, runs, &libc_stats[i]);
 			}
 			free_trace(trace);
 		}
@@ -304,43 +481,47 @@ int main(int argc, char **argv)
 		printf("\nTesting mm malloc\n");
 
 	/* Allocate the mm stats array, with one stats_t struct per tracefile */
-	mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
-	if (mm_stats == NULL)
-		unix_error("mm_stats calloc in main failed");
-
-	/* Initialize the simulated memory system in memlib.c */
-	mem_init();
+	mm_results = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+	if (mm_results == NULL)
+		unix_error("mm_results calloc in main failed");
 
 	/* Evaluate student's mm malloc package using the K-best scheme */
-	for (i = 0; i < num_tracefiles; i++)
+	if (jobs > 1)
+		eval_mm_parallel(tracefiles, num_tracefiles, mm_results);
+	else
 	{
-		trace = read_trace(tracedir, tracefiles[i]);
-		mm_stats[i].ops = trace->num_ops;
-		if (verbose > 1)
-			printf("Checking mm_malloc for correctness, ");
-		mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-		if (mm_stats[i].valid)
-		{
-			if (verbose > 1)
-				printf("efficiency, ");
-			mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-			speed_params.trace = trace;
-			speed_params.ranges = ranges;
-			if (verbose > 1)
-				printf("and performance.\n");
-			mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-		}
-		free_trace(trace);
+		/* Initialize the simulated memory system in memlib.c */
+		mem_init();
+
+		for (i = 0; i < num_tracefiles; i++)
+			eval_mm_trace(tracefiles[i], i, &mm_results[i]);
 	}
 
 	/* Display the mm results in a compact table */
 	if (verbose)
 	{
 		printf("\nResults for mm malloc:\n");
-		printresults(num_tracefiles, mm_stats);
+		printresults(num_tracefiles, mm_results);
+		printf("\n");
+	}
+
+	/* Display the tail latencies, which are never folded into the index */
+	if (latency)
+	{
+		printf("Per-op latency for mm malloc (cycles):\n");
+		printlatency(num_tracefiles, mm_results);
 		printf("\n");
 	}
 
+	/* Display the hardware event rates */
+	if (counters)
+	{
+		printf("Hardware events per op for mm malloc:\n");
+		printcounters(num_tracefiles, mm_results);
+		printf("\n");
+		perfctr_deinit();
+	}
+
 	/*
 	 * Accumulate the aggregate statistics for the student's mm package
 	 */
@@ -350,10 +531,10 @@ int main(int argc, char **argv)
 	numcorrect = 0;
 	for (i = 0; i < num_tracefiles; i++)
 	{
-		secs += mm_stats[i].secs;
-		ops += mm_stats[i].ops;
-		util += mm_stats[i].util;
-		if (mm_stats[i].valid)
+		secs += mm_results[i].secs;
+		ops += mm_results[i].ops;
+		util += mm_results[i].util;
+		if (mm_results[i].valid)
 			numcorrect++;
 	}
 	avg_mm_util = util / num_tracefiles;
@@ -394,7 +575,17 @@ int main(int argc, char **argv)
 		printf("perfidx:%.0f\n", perfindex);
 	}
 
-	exit(0);
+	/* Emit machine-readable results and check them against a baseline */
+	if (csvfile)
+		write_csv(csvfile, tracefiles, num_tracefiles, mm_results, latency);
+	if (jsonfile)
+		write_json(jsonfile, tracefiles, num_tracefiles, mm_results,
+				   latency, perfindex);
+	if (basefile)
+		regressions = compare_baseline(basefile, tracefiles,
+									   num_tracefiles, mm_results);
+
+	exit(regressions ? 2 : 0);
 }
 
 /*****************************************************************
@@ -510,13 +701,14 @@ static void clear_ranges(range_t **ranges)
  */
 static trace_t *read_trace(char *tracedir, char *filename)
 {
-	FILE *tracefile;
+	tracefile_t *tracefile;
 	trace_t *trace;
-	char type[MAXLINE];
+	tf_op_t op;
 	char path[MAXLINE];
-	unsigned index, size;
 	unsigned max_index = 0;
-	unsigned op_index;
+	unsigned op_index, k;
+	int *cur_size;
+	int rc;
 
 	if (verbose > 1)
 		printf("Reading tracefile: %s\n", filename);
@@ -525,18 +717,18 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	if ((trace = (trace_t *)malloc(sizeof(trace_t))) == NULL)
 		unix_error("malloc 1 failed in read_trance");
 
-	/* Read the trace file header */
+	/* Read the trace file header (text .rep or binary, see traces/README) */
 	strcpy(path, tracedir);
 	strcat(path, filename);
-	if ((tracefile = fopen(path, "r")) == NULL)
+	if ((tracefile = tf_open(path)) == NULL)
 	{
 		sprintf(msg, "Could not open %s in read_trace", path);
 		unix_error(msg);
 	}
-	fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
-	fscanf(tracefile, "%d", &(trace->num_ids));
-	fscanf(tracefile, "%d", &(trace->num_ops));
-	fscanf(tracefile, "%d", &(trace->weight)); /* not used */
+	trace->sugg_heapsize = (int)tracefile->sugg_heapsize; /* not used */
+	trace->num_ids = (int)tracefile->num_ids;
+	trace->num_ops = (int)tracefile->num_ops;
+	trace->weight = (int)tracefile->weight; /* not used */
 
 	/* We'll store each request line in the trace in this array */
 	if ((trace->ops =
@@ -553,46 +745,159 @@ static trace_t *read_trace(char *tracedir, char *filename)
 			 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
 		unix_error("malloc 4 failed in read_trace");
 
-	/* read every request line in the trace file */
-	index = 0;
+	/* The size of each id as of the current request, for sized frees */
+	if ((cur_size = (int *)calloc(trace->num_ids, sizeof(int))) == NULL)
+		unix_error("malloc 5 failed in read_trace");
+
+	/* read every request in the trace file */
 	op_index = 0;
-	while (fscanf(tracefile, "%s", type) != EOF)
+	while ((rc = tf_next(tracefile, &op)) > 0 && op_index < trace->num_ops)
 	{
-		switch (type[0])
+		if (op.index >= (unsigned)trace->num_ids ||
+			((op.type == 'A' || op.type == 'F') &&
+			 op.count > (unsigned)trace->num_ids - op.index))
+		{
+			printf("Request id %u out of range at line %lld in tracefile %s\n",
+				   op.index, tracefile->line, path);
+			exit(1);
+		}
+		switch (op.type)
 		{
 		case 'a':
-			fscanf(tracefile, "%u %u", &index, &size);
 			trace->ops[op_index].type = ALLOC;
-			trace->ops[op_index].index = index;
-			trace->ops[op_index].size = size;
-			max_index = (index > max_index) ? index : max_index;
+			trace->ops[op_index].size = op.size;
+			max_index = (op.index > max_index) ? op.index : max_index;
 			break;
 		case 'r':
-			fscanf(tracefile, "%u %u", &index, &size);
 			trace->ops[op_index].type = REALLOC;
-			trace->ops[op_index].index = index;
-			trace->ops[op_index].size = size;
-			max_index = (index > max_index) ? index : max_index;
+			trace->ops[op_index].size = op.size;
+			max_index = (op.index > max_index) ? op.index : max_index;
+			break;
+		case 'c':
+			trace->ops[op_index].type = CALLOC;
+			trace->ops[op_index].size = op.size;
+			max_index = (op.index > max_index) ? op.index : max_index;
+			break;
+		case 'm':
+			if (op.align == 0 || (op.align & (op.align - 1)) != 0)
+			{
+				printf("Alignment %u is not a power of two at line %lld "
+					   "in tracefile %s\n", op.align, tracefile->line, path);
+				exit(1);
+			}
+			trace->ops[op_index].type = MEMALIGN;
+			trace->ops[op_index].size = op.size;
+			trace->ops[op_index].align = op.align;
+			max_index = (op.index > max_index) ? op.index : max_index;
+			break;
+		case 'A':
+			trace->ops[op_index].type = ALLOC_BATCH;
+			trace->ops[op_index].size = op.size;
+			trace->ops[op_index].count = op.count;
+			if (op.count > 0 && op.index + op.count - 1 > max_index)
+				max_index = op.index + op.count - 1;
+			for (k = 0; k < op.count; k++)
+				cur_size[op.index + k] = op.size;
 			break;
 		case 'f':
-			fscanf(tracefile, "%ud", &index);
 			trace->ops[op_index].type = FREE;
-			trace->ops[op_index].index = index;
+			trace->ops[op_index].size = cur_size[op.index];
+			break;
+		case 'F':
+			trace->ops[op_index].type = FREE_BATCH;
+			trace->ops[op_index].count = op.count;
 			break;
 		default:
 			printf("Bogus type character (%c) in tracefile %s\n",
-				   type[0], path);
+				   op.type, path);
 			exit(1);
 		}
+		trace->ops[op_index].index = op.index;
+		trace->ops[op_index].hint = MM_HINT_NONE;
+		if (op.type == 'a' || op.type == 'c' || op.type == 'm' || op.type == 'r')
+			cur_size[op.index] = op.size;
 		op_index++;
 	}
-	fclose(tracefile);
+	if (rc < 0)
+	{
+		printf("Malformed request at line %lld in tracefile %s\n",
+			   tracefile->line, path);
+		exit(1);
+	}
+	tf_close(tracefile);
+	free(cur_size);
 	assert(max_index == trace->num_ids - 1);
 	assert(trace->num_ops == op_index);
 
+	if (hints)
+		predict_lifetimes(trace);
 	return trace;
 }
 
+/*
+ * predict_lifetimes - Hint MM_HINT_LONG on the alloc requests predicted
+ *    to outlive LONG_LIVED of the requests in the trace. The predictor
+ *    is trained on the trace itself, like a profile. It keys every
+ *    alloc on its size and the size of the alloc before it, a stand-in
+ *    for the call site that real allocators get from the stack, and
+ *    predicts long-lived for the keys most of whose allocs were (a
+ *    block never freed counts as long-lived).
+ */
+static void predict_lifetimes(trace_t *trace)
+{
+	struct
+	{
+		int size, prev; /* the key */
+		int votes;		/* long-lived allocs minus short-lived ones */
+	} *table;
+	int *born, *slot;	/* alloc op of each live id, key of each op */
+	int i, id, nslots, prev = 0, longlived = trace->num_ops * LONG_LIVED;
+	unsigned h;
+
+	for (nslots = 1024; nslots < 2 * trace->num_ops; nslots *= 2)
+		;
+	if ((table = calloc(nslots, sizeof(*table))) == NULL ||
+		(born = malloc(trace->num_ids * sizeof(int))) == NULL ||
+		(slot = malloc(trace->num_ops * sizeof(int))) == NULL)
+		unix_error("malloc failed in predict_lifetimes");
+	for (id = 0; id < trace->num_ids; id++)
+		born[id] = -1;
+
+	/* Vote with the lifetime of every alloc */
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		id = trace->ops[i].index;
+		if (trace->ops[i].type == ALLOC)
+		{
+			h = ((unsigned)trace->ops[i].size * 2654435761u ^ (unsigned)prev) &
+				(nslots - 1);
+			while (table[h].size != 0 &&
+				   (table[h].size != trace->ops[i].size || table[h].prev != prev))
+				h = (h + 1) & (nslots - 1);
+			table[h].size = trace->ops[i].size;
+			table[h].prev = prev;
+			slot[i] = h;
+			born[id] = i;
+			prev = trace->ops[i].size;
+		}
+		else if (trace->ops[i].type == FREE && born[id] >= 0)
+		{
+			table[slot[born[id]]].votes += (i - born[id] > longlived) ? 1 : -1;
+			born[id] = -1;
+		}
+	}
+	for (id = 0; id < trace->num_ids; id++)
+		if (born[id] >= 0)
+			table[slot[born[id]]].votes++;
+
+	for (i = 0; i < trace->num_ops; i++)
+		if (trace->ops[i].type == ALLOC && table[slot[i]].votes > 0)
+			trace->ops[i].hint = MM_HINT_LONG;
+	free(table);
+	free(born);
+	free(slot);
+}
+
 /*
  * free_trace - Free the trace record and the three arrays it points
  *              to, all of which were allocated in read_trace().
@@ -633,6 +938,8 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 		malloc_error(tracenum, 0, "mm_init failed.");
 		return 0;
 	}
+	if (!check_posix_memalign(tracenum))
+		return 0;
 
 	/* Interpret each operation in the trace in order */
 	for (i = 0; i < trace->num_ops; i++)
@@ -644,11 +951,31 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 		{
 
 		case ALLOC: /* mm_malloc */
+		case CALLOC: /* mm_calloc */
+		case MEMALIGN: /* mm_memalign */
+
+			/* Call the student's malloc, calloc or memalign */
+			if (trace->ops[i].type == CALLOC)
+				p = mm_calloc(1, size);
+			else if (trace->ops[i].type == MEMALIGN)
+				p = mm_memalign(trace->ops[i].align, size);
+			else
+				p = mm_malloc_hint(size, trace->ops[i].hint);
+			if (p == NULL)
+			{
+				malloc_error(tracenum, i, trace->ops[i].type == CALLOC ? "mm_calloc failed." :
+							 trace->ops[i].type == MEMALIGN ? "mm_memalign failed." :
+							 "mm_malloc failed.");
+				return 0;
+			}
 
-			/* Call the student's malloc */
-			if ((p = mm_malloc(size)) == NULL)
+			/* A memalign'd block must start on the requested boundary */
+			if (trace->ops[i].type == MEMALIGN &&
+				((size_t)p & (trace->ops[i].align - 1)) != 0)
 			{
-				malloc_error(tracenum, i, "mm_malloc failed.");
+				sprintf(msg, "mm_memalign returned %p, not aligned to %d",
+						p, trace->ops[i].align);
+				malloc_error(tracenum, i, msg);
 				return 0;
 			}
 
@@ -660,6 +987,20 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 			if (add_range(ranges, p, size, tracenum, i) == 0)
 				return 0;
 
+			/* A calloc'd block must read as zero */
+			if (trace->ops[i].type == CALLOC)
+			{
+				for (j = 0; j < size; j++)
+				{
+					if (p[j] != 0)
+					{
+						malloc_error(tracenum, i, "mm_calloc returned a "
+												  "block that is not zeroed");
+						return 0;
+					}
+				}
+			}
+
 			/* ADDED: cgw
 			 * fill range with low byte of index.  This will be used later
 			 * if we realloc the block and wish to make sure that the old
@@ -699,7 +1040,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 				oldsize = size;
 			for (j = 0; j < oldsize; j++)
 			{
-				if (newp[j] != (index & 0xFF))
+				if ((unsigned char)newp[j] != (index & 0xFF))
 				{
 					malloc_error(tracenum, i, "mm_realloc did not preserve the "
 											  "data from old block");
@@ -718,18 +1059,90 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 			/* Remove region from list and call student's free function */
 			p = trace->blocks[index];
 			remove_range(ranges, p);
-			mm_free(p);
+			if (sized_free)
+				mm_free_sized(p, trace->ops[i].size);
+			else
+				mm_free(p);
+			break;
+
+		case ALLOC_BATCH: /* mm_malloc_batch */
+
+			/* The blocks land in consecutive slots, and each is checked
+			   like the result of a single malloc */
+			if (mm_malloc_batch(size, trace->ops[i].count,
+								(void **)(trace->blocks + index)) !=
+				(size_t)trace->ops[i].count)
+			{
+				malloc_error(tracenum, i, "mm_malloc_batch failed.");
+				return 0;
+			}
+			for (j = 0; j < trace->ops[i].count; j++)
+			{
+				p = trace->blocks[index + j];
+				if (add_range(ranges, p, size, tracenum, i) == 0)
+					return 0;
+				memset(p, (index + j) & 0xFF, size);
+				trace->block_sizes[index + j] = size;
+			}
+			break;
+
+		case FREE_BATCH: /* mm_free_batch */
+			for (j = 0; j < trace->ops[i].count; j++)
+				remove_range(ranges, trace->blocks[index + j]);
+			mm_free_batch((void **)(trace->blocks + index), trace->ops[i].count);
 			break;
 
 		default:
 			app_error("Nonexistent request type in eval_mm_valid");
 		}
+
+		/* Check the blocks the op touched, and now and then all of them */
+		if (check_interval > 0 &&
+			mm_check((i + 1) % check_interval == 0 || i + 1 == trace->num_ops ?
+					 MM_CHECK_FULL : MM_CHECK_INCR) != 0)
+		{
+			malloc_error(tracenum, i, "mm_check found the heap inconsistent.");
+			return 0;
+		}
 	}
 
 	/* As far as we know, this is a valid malloc package */
 	return 1;
 }
 
+/*
+ * check_posix_memalign - Check the argument checks of mm_posix_memalign,
+ *     which traces cannot express: an alignment that is zero, not a
+ *     power of two, or smaller than a pointer fails with EINVAL, and a
+ *     size of 0 succeeds with NULL. None of them allocates anything.
+ */
+static int check_posix_memalign(int tracenum)
+{
+	static const size_t bad[] = {0, sizeof(void *) / 2, 3 * sizeof(void *)};
+	unsigned int i;
+	void *p;
+	int err;
+
+	for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+	{
+		if ((err = mm_posix_memalign(&p, bad[i], 16)) != EINVAL)
+		{
+			sprintf(msg, "mm_posix_memalign returned %d, not EINVAL, "
+					"for alignment %zu", err, bad[i]);
+			malloc_error(tracenum, 0, msg);
+			return 0;
+		}
+	}
+	p = &p;
+	if ((err = mm_posix_memalign(&p, 2 * sizeof(void *), 0)) != 0 || p != NULL)
+	{
+		sprintf(msg, "mm_posix_memalign returned %d and %p for size 0", err, p);
+		malloc_error(tracenum, 0, msg);
+		return 0;
+	}
+	return 1;
+}
+
 /*
  * eval_mm_util - Evaluate the space utilization of the student's package
  *   The idea is to remember the high water mark "hwm" of the heap for
@@ -743,7 +1156,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  */
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 {
-	int i;
+	int i, j, n;
 	int index;
 	int size, newsize, oldsize;
 	int max_total_size = 0;
@@ -762,10 +1175,18 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 		{
 
 		case ALLOC: /* mm_alloc */
+		case CALLOC: /* mm_calloc */
+		case MEMALIGN: /* mm_memalign */
 			index = trace->ops[i].index;
 			size = trace->ops[i].size;
 
-			if ((p = mm_malloc(size)) == NULL)
+			if (trace->ops[i].type == CALLOC)
+				p = mm_calloc(1, size);
+			else if (trace->ops[i].type == MEMALIGN)
+				p = mm_memalign(trace->ops[i].align, size);
+			else
+				p = mm_malloc_hint(size, trace->ops[i].hint);
+			if (p == NULL)
 				app_error("mm_malloc failed in eval_mm_util");
 
 			/* Remember region and size */
@@ -806,7 +1227,10 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 			size = trace->block_sizes[index];
 			p = trace->blocks[index];
 
-			mm_free(p);
+			if (sized_free)
+				mm_free_sized(p, trace->ops[i].size);
+			else
+				mm_free(p);
 
 			/* Keep track of current total size
 			 * of all allocated blocks */
@@ -814,6 +1238,28 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 
 			break;
 
+		case ALLOC_BATCH: /* mm_malloc_batch */
+			index = trace->ops[i].index;
+			size = trace->ops[i].size;
+			n = trace->ops[i].count;
+
+			if (mm_malloc_batch(size, n, (void **)(trace->blocks + index)) != (size_t)n)
+				app_error("mm_malloc_batch failed in eval_mm_util");
+			for (j = 0; j < n; j++)
+				trace->block_sizes[index + j] = size;
+
+			total_size += size * n;
+			max_total_size = (total_size > max_total_size) ? total_size : max_total_size;
+			break;
+
+		case FREE_BATCH: /* mm_free_batch */
+			index = trace->ops[i].index;
+			n = trace->ops[i].count;
+			for (j = 0; j < n; j++)
+				total_size -= trace->block_sizes[index + j];
+			mm_free_batch((void **)(trace->blocks + index), n);
+			break;
+
 		default:
 			app_error("Nonexistent request type in eval_mm_util");
 		}
@@ -845,11 +1291,27 @@ static void eval_mm_speed(void *ptr)
 		case ALLOC: /* mm_malloc */
 			index = trace->ops[i].index;
 			size = trace->ops[i].size;
-			if ((p = mm_malloc(size)) == NULL)
+			if ((p = mm_malloc_hint(size, trace->ops[i].hint)) == NULL)
 				app_error("mm_malloc error in eval_mm_speed");
 			trace->blocks[index] = p;
 			break;
 
+		case CALLOC: /* mm_calloc */
+			index = trace->ops[i].index;
+			size = trace->ops[i].size;
+			if ((p = mm_calloc(1, size)) == NULL)
+				app_error("mm_calloc error in eval_mm_speed");
+			trace->blocks[index] = p;
+			break;
+
+		case MEMALIGN: /* mm_memalign */
+			index = trace->ops[i].index;
+			size = trace->ops[i].size;
+			if ((p = mm_memalign(trace->ops[i].align, size)) == NULL)
+				app_error("mm_memalign error in eval_mm_speed");
+			trace->blocks[index] = p;
+			break;
+
 		case REALLOC: /* mm_realloc */
 			index = trace->ops[i].index;
 			newsize = trace->ops[i].size;
@@ -862,7 +1324,24 @@ static void eval_mm_speed(void *ptr)
 		case FREE: /* mm_free */
 			index = trace->ops[i].index;
 			block = trace->blocks[index];
-			mm_free(block);
+			if (sized_free)
+				mm_free_sized(block, trace->ops[i].size);
+			else
+				mm_free(block);
+			break;
+
+		case ALLOC_BATCH: /* mm_malloc_batch */
+			index = trace->ops[i].index;
+			size = trace->ops[i].size;
+			if (mm_malloc_batch(size, trace->ops[i].count,
+								(void **)(trace->blocks + index)) !=
+				(size_t)trace->ops[i].count)
+				app_error("mm_malloc_batch error in eval_mm_speed");
+			break;
+
+		case FREE_BATCH: /* mm_free_batch */
+			index = trace->ops[i].index;
+			mm_free_batch((void **)(trace->blocks + index), trace->ops[i].count);
 			break;
 
 		default:
@@ -870,6 +1349,553 @@ static void eval_mm_speed(void *ptr)
 		}
 }
 
+/*
+ * eval_mm_latency - Replay the trace LATRUNS times, timing every
+ *    request individually with the cycle counter, and summarize the
+ *    distribution for each request type. fsecs() only sees the total,
+ *    so a single slow heap extension or a long fit search is invisible
+ *    there; here it shows up in the tail. The cost of reading the
+ *    counter is measured up front and subtracted from every sample.
+ */
+static void eval_mm_latency(trace_t *trace, latsum_t *lat)
+{
+	static lathist_t hist[NUM_OPTYPES];
+	unsigned long long t0, t1, ovh, cyc;
+	size_t got;
+	int i, run, index, type;
+	char *p;
+
+	/* Cost of back-to-back counter reads, best of a few tries */
+	ovh = ~0ULL;
+	for (i = 0; i < 64; i++)
+	{
+		t0 = read_cycles();
+		t1 = read_cycles();
+		if (t1 - t0 < ovh)
+			ovh = t1 - t0;
+	}
+
+	for (type = 0; type < NUM_OPTYPES; type++)
+		lathist_reset(&hist[type]);
+
+	for (run = 0; run < LATRUNS; run++)
+	{
+		/* Reset the heap and initialize the mm package */
+		mem_reset_brk();
+		if (mm_init() < 0)
+			app_error("mm_init failed in eval_mm_latency");
+
+		for (i = 0; i < trace->num_ops; i++)
+		{
+			index = trace->ops[i].index;
+			switch (trace->ops[i].type)
+			{
+
+			case ALLOC: /* mm_malloc */
+				t0 = read_cycles();
+				p = mm_malloc_hint(trace->ops[i].size, trace->ops[i].hint);
+				t1 = read_cycles();
+				if (p == NULL)
+					app_error("mm_malloc error in eval_mm_latency");
+				trace->blocks[index] = p;
+				break;
+
+			case CALLOC: /* mm_calloc */
+				t0 = read_cycles();
+				p = mm_calloc(1, trace->ops[i].size);
+				t1 = read_cycles();
+				if (p == NULL)
+					app_error("mm_calloc error in eval_mm_latency");
+				trace->blocks[index] = p;
+				break;
+
+			case MEMALIGN: /* mm_memalign */
+				t0 = read_cycles();
+				p = mm_memalign(trace->ops[i].align, trace->ops[i].size);
+				t1 = read_cycles();
+				if (p == NULL)
+					app_error("mm_memalign error in eval_mm_latency");
+				trace->blocks[index] = p;
+				break;
+
+			case REALLOC: /* mm_realloc */
+				t0 = read_cycles();
+				p = mm_realloc(trace->blocks[index], trace->ops[i].size);
+				t1 = read_cycles();
+				if (p == NULL)
+					app_error("mm_realloc error in eval_mm_latency");
+				trace->blocks[index] = p;
+				break;
+
+			case FREE: /* mm_free */
+				if (sized_free)
+				{
+					t0 = read_cycles();
+					mm_free_sized(trace->blocks[index], trace->ops[i].size);
+					t1 = read_cycles();
+				}
+				else
+				{
+					t0 = read_cycles();
+					mm_free(trace->blocks[index]);
+					t1 = read_cycles();
+				}
+				break;
+
+			case ALLOC_BATCH: /* mm_malloc_batch, one sample per batch */
+				t0 = read_cycles();
+				got = mm_malloc_batch(trace->ops[i].size, trace->ops[i].count,
+									  (void **)(trace->blocks + index));
+				t1 = read_cycles();
+				if (got != (size_t)trace->ops[i].count)
+					app_error("mm_malloc_batch error in eval_mm_latency");
+				break;
+
+			case FREE_BATCH: /* mm_free_batch */
+				t0 = read_cycles();
+				mm_free_batch((void **)(trace->blocks + index), trace->ops[i].count);
+				t1 = read_cycles();
+				break;
+
+			default:
+				app_error("Nonexistent request type in eval_mm_latency");
+			}
+			cyc = t1 - t0;
+			lathist_add(&hist[trace->ops[i].type], cyc > ovh ? cyc - ovh : 0);
+		}
+	}
+
+	for (type = 0; type < NUM_OPTYPES; type++)
+	{
+		lat[type].count = hist[type].count;
+		lat[type].p50 = lathist_percentile(&hist[type], 50.0);
+		lat[type].p99 = lathist_percentile(&hist[type], 99.0);
+		lat[type].p999 = lathist_percentile(&hist[type], 99.9);
+		lat[type].max = hist[type].count ? hist[type].max : 0;
+	}
+}
+
+/*
+ * frag_visit - mm_heap_walk callback that accumulates a heapscan_t
+ */
+static void frag_visit(void *bp, size_t size, int alloc, void *arg)
+{
+	heapscan_t *scan = (heapscan_t *)arg;
+	size_t lim;
+	int k;
+
+	if (alloc)
+	{
+		scan->alloc_bytes += size;
+		scan->tail_free = 0;
+		return;
+	}
+	scan->tail_free += size;
+	scan->free_bytes += size;
+	scan->free_blocks++;
+	if (size > scan->largest_free)
+		scan->largest_free = size;
+	for (k = 0, lim = 32; size >= lim && k < FRAG_CLASSES - 1; lim <<= 1)
+		k++;
+	scan->free_class[k] += size;
+}
+
+/*
+ * eval_mm_frag - Replay the trace and every frag_interval ops (and
+ *    after the last one) walk the heap, writing one CSV row with the
+ *    live payload, the bytes in allocated blocks (the excess over the
+ *    payload is internal fragmentation), the free bytes by size class
+ *    and the largest free block (external fragmentation), and the heap
+ *    size. "grown" and "extends" say how much and how often the heap
+ *    grew since the previous row, which points at the phase of the
+ *    workload that forced extend_heap; "tail_free" is the free space
+ *    at the end of the heap that growth has left unused. "rss" is the
+ *    part of the heap resident in memory, and "purged" and "refaulted"
+ *    the bytes decay has given back to the OS and handed out again so
+ *    far, and "splits" and "coalesces" the block splits and merges so
+ *    far, from mm_stats, whose free space is checked against the walk.
+ *    The timeline goes to <trace>.frag.csv in the current directory.
+ */
+static void eval_mm_frag(trace_t *trace, char *filename)
+{
+	FILE *fp;
+	char path[MAXLINE];
+	char *base;
+	heapscan_t scan;
+	mm_stats_t st;
+	size_t purged, refaulted;
+	double live = 0, last_heap = 0, heap, prev;
+	int i, j, k, n, index, size, extends = 0, total_extends = 0;
+	char *p;
+
+	base = strrchr(filename, '/') ? strrchr(filename, '/') + 1 : filename;
+	snprintf(path, sizeof(path), "%s.frag.csv", base);
+	if ((fp = fopen(path, "w")) == NULL)
+	{
+		snprintf(msg, MAXLINE, "Could not open %.900s in eval_mm_frag", path);
+		unix_error(msg);
+	}
+	fprintf(fp, "op,live,heap,alloc_bytes,internal,free_bytes,free_blocks,"
+				"largest_free,external,grown,extends,tail_free,rss,purged,refaulted,"
+				"splits,coalesces");
+	for (k = 0; k < FRAG_CLASSES - 1; k++)
+		fprintf(fp, ",free_lt%d", 32 << k);
+	fprintf(fp, ",free_ge%d\n", 32 << (FRAG_CLASSES - 2));
+
+	/* Reset the heap and initialize the mm package */
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_frag");
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+		prev = mem_heapsize();
+		switch (trace->ops[i].type)
+		{
+
+		case ALLOC: /* mm_malloc */
+		case CALLOC: /* mm_calloc */
+		case MEMALIGN: /* mm_memalign */
+			if (trace->ops[i].type == CALLOC)
+				p = mm_calloc(1, size);
+			else if (trace->ops[i].type == MEMALIGN)
+				p = mm_memalign(trace->ops[i].align, size);
+			else
+				p = mm_malloc_hint(size, trace->ops[i].hint);
+			if (p == NULL)
+				app_error("mm_malloc failed in eval_mm_frag");
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			live += size;
+			break;
+
+		case REALLOC: /* mm_realloc */
+			if ((p = mm_realloc(trace->blocks[index], size)) == NULL)
+				app_error("mm_realloc failed in eval_mm_frag");
+			live += size - (double)trace->block_sizes[index];
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			break;
+
+		case FREE: /* mm_free */
+			if (sized_free)
+				mm_free_sized(trace->blocks[index], trace->ops[i].size);
+			else
+				mm_free(trace->blocks[index]);
+			live -= trace->block_sizes[index];
+			break;
+
+		case ALLOC_BATCH: /* mm_malloc_batch */
+			n = trace->ops[i].count;
+			if (mm_malloc_batch(size, n, (void **)(trace->blocks + index)) != (size_t)n)
+				app_error("mm_malloc_batch failed in eval_mm_frag");
+			for (j = 0; j < n; j++)
+				trace->block_sizes[index + j] = size;
+			live += (double)size * n;
+			break;
+
+		case FREE_BATCH: /* mm_free_batch */
+			n = trace->ops[i].count;
+			for (j = 0; j < n; j++)
+				live -= trace->block_sizes[index + j];
+			mm_free_batch((void **)(trace->blocks + index), n);
+			break;
+
+		default:
+			app_error("Nonexistent request type in eval_mm_frag");
+		}
+		heap = mem_heapsize();
+		if (heap > prev)
+		{
+			extends++;
+			total_extends++;
+		}
+
+		if (i % frag_interval != 0 && i != trace->num_ops - 1)
+			continue;
+
+		memset(&scan, 0, sizeof(scan));
+		mm_heap_walk(frag_visit, &scan);
+		mm_decay_counts(&purged, &refaulted);
+		mm_stats(&st);
+		if (st.free_bytes != scan.free_bytes || st.largest_free != scan.largest_free)
+			app_error("mm_stats disagrees with mm_heap_walk in eval_mm_frag");
+		fprintf(fp, "%d,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.4f,%.0f,%d,%.0f,%zu,%zu,%zu,%zu,%zu",
+				i + 1, live, heap, scan.alloc_bytes, scan.alloc_bytes - live,
+				scan.free_bytes, scan.free_blocks, scan.largest_free,
+				scan.free_bytes > 0 ? 1.0 - scan.largest_free / scan.free_bytes : 0.0,
+				heap - last_heap, extends, scan.tail_free, mem_resident(), purged,
+				refaulted, st.splits, st.coalesces);
+		for (k = 0; k < FRAG_CLASSES; k++)
+			fprintf(fp, ",%.0f", scan.free_class[k]);
+		fprintf(fp, "\n");
+		last_heap = heap;
+		extends = 0;
+	}
+	fclose(fp);
+	if (verbose > 1)
+		printf("Wrote fragmentation timeline to %s (%d heap extensions)\n",
+			   path, total_extends);
+}
+
+/*
+ * write_profile - Stop the heap profiler and write what it sampled over
+ *    every replay of the trace to <trace>.heap in the current directory,
+ *    for pprof. Objects still live are those the last replay left.
+ */
+static void write_profile(char *filename)
+{
+	FILE *fp;
+	char path[MAXLINE];
+	char *base;
+
+	base = strrchr(filename, '/') ? strrchr(filename, '/') + 1 : filename;
+	snprintf(path, sizeof(path), "%s.heap", base);
+	if ((fp = fopen(path, "w")) == NULL)
+	{
+		snprintf(msg, MAXLINE, "Could not open %.900s in write_profile", path);
+		unix_error(msg);
+	}
+	if (mm_prof_dump(fp) < 0)
+		app_error("mm_prof_dump failed in write_profile");
+	fclose(fp);
+	mm_prof_start(0);
+	if (verbose > 1)
+		printf("Wrote heap profile to %s\n", path);
+}
+
+/*
+ * eval_mm_counters - Count hardware events over PMCRUNS runs of
+ *    eval_mm_speed and store the average per run. This is separate
+ *    from the fsecs() measurement so that starting and reading the
+ *    counters never perturbs the reported throughput.
+ */
+static void eval_mm_counters(speed_t *speed_params, double *pmc)
+{
+	int i, run;
+
+	perfctr_start();
+	for (run = 0; run < PMCRUNS; run++)
+		eval_mm_speed(speed_params);
+	perfctr_stop(pmc);
+
+	for (i = 0; i < PERFCTR_NEVENTS; i++)
+		if (pmc[i] >= 0)
+			pmc[i] /= PMCRUNS;
+}
+
+/*
+ * eval_mm_trace - Read one trace and run every evaluation of the mm
+ *    package that is enabled on it, filling in its stats record
+ */
+static void eval_mm_trace(char *filename, int tracenum, stats_t *stats)
+{
+	trace_t *trace;
+	range_t *ranges = NULL;
+	speed_t speed_params;
+
+	trace = read_trace(tracedir, filename);
+	stats->ops = trace->num_ops;
+	if (prof_rate)
+		mm_prof_start(prof_rate);
+	if (verbose > 1)
+		printf("Checking mm_malloc for correctness, ");
+	stats->valid = eval_mm_valid(trace, tracenum, &ranges);
+	if (stats->valid)
+	{
+		if (verbose > 1)
+			printf("efficiency, ");
+		stats->util = eval_mm_util(trace, tracenum, &ranges);
+		stats->heap = mem_heapsize();
+		speed_params.trace = trace;
+		speed_params.ranges = ranges;
+		if (verbose > 1)
+			printf("and performance.\n");
+		time_trace(eval_mm_speed, &speed_params, runs, stats);
+		if (latency)
+		{
+			if (verbose > 1)
+				printf("Measuring per-op latency.\n");
+			eval_mm_latency(trace, stats->lat);
+		}
+		if (counters)
+		{
+			if (verbose > 1)
+				printf("Counting hardware events.\n");
+			eval_mm_counters(&speed_params, stats->pmc);
+		}
+		if (frag_interval)
+		{
+			if (verbose > 1)
+				printf("Recording fragmentation timeline.\n");
+			eval_mm_frag(trace, filename);
+		}
+	}
+	if (prof_rate)
+		write_profile(filename);
+	clear_ranges(&ranges);
+	free_trace(trace);
+}
+
+/*
+ * pin_to_slot - Bind the calling process to the slot'th CPU it is
+ *    allowed to run on, so concurrent workers do not migrate onto each
+ *    other's cores in the middle of a timing run
+ */
+static void pin_to_slot(int slot)
+{
+#ifdef __linux__
+	cpu_set_t allowed, mine;
+	int cpu, k, ncpus;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+		return;
+	ncpus = CPU_COUNT(&allowed);
+	if (ncpus == 0)
+		return;
+	slot %= ncpus;
+	for (cpu = 0, k = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (!CPU_ISSET(cpu, &allowed))
+			continue;
+		if (k++ == slot)
+		{
+			CPU_ZERO(&mine);
+			CPU_SET(cpu, &mine);
+			sched_setaffinity(0, sizeof(mine), &mine);
+			return;
+		}
+	}
+#endif
+}
+
+/*
+ * eval_mm_parallel - Evaluate the traces with up to jobs worker
+ *    processes at once, one fork per trace. The allocator and memlib
+ *    keep their state in globals, so threads are out of the question,
+ *    but a forked worker gets its own copy of everything: it calls
+ *    mem_init() for a private heap, runs eval_mm_trace(), and sends its
+ *    stats record and error count back over a pipe. Workers are pinned
+ *    to distinct CPUs; note that their throughput is still measured
+ *    while they share caches and memory bandwidth with each other.
+ */
+static void eval_mm_parallel(char **tracefiles, int n, stats_t *stats)
+{
+	typedef struct
+	{
+		stats_t stats; /* the worker's stats for its trace */
+		int errors;	   /* number of malloc_error()s it reported */
+	} result_t;
+	result_t result;
+	pid_t *pids, pid;
+	int *fds, *slots, fd[2];
+	int next = 0, running = 0, i, slot, status;
+	ssize_t len;
+
+	pids = (pid_t *)calloc(n, sizeof(pid_t));
+	fds = (int *)calloc(n, sizeof(int));
+	slots = (int *)calloc(jobs, sizeof(int)); /* trace+1 using each slot */
+	if (pids == NULL || fds == NULL || slots == NULL)
+		unix_error("calloc failed in eval_mm_parallel");
+
+	while (next < n || running > 0)
+	{
+		/* Start workers until every slot is busy */
+		while (next < n && running < jobs)
+		{
+			for (slot = 0; slots[slot]; slot++)
+				;
+			if (pipe(fd) < 0)
+				unix_error("pipe failed in eval_mm_parallel");
+			fflush(stdout); /* don't let the child repeat buffered output */
+			if ((pid = fork()) < 0)
+				unix_error("fork failed in eval_mm_parallel");
+			if (pid == 0)
+			{
+				close(fd[0]);
+				pin_to_slot(slot);
+				if (counters) /* counters follow the pid that opened them */
+				{
+					perfctr_deinit();
+					perfctr_init();
+				}
+				mem_init();
+				memset(&result, 0, sizeof(result));
+				eval_mm_trace(tracefiles[next], next, &result.stats);
+				result.errors = errors;
+				fflush(stdout);
+				if (write(fd[1], &result, sizeof(result)) != sizeof(result))
+					_exit(1);
+				_exit(0);
+			}
+			close(fd[1]);
+			pids[next] = pid;
+			fds[next] = fd[0];
+			slots[slot] = next + 1;
+			next++;
+			running++;
+		}
+
+		/* Collect whichever worker finishes first */
+		if ((pid = wait(&status)) < 0)
+			unix_error("wait failed in eval_mm_parallel");
+		for (i = 0; i < n && pids[i] != pid; i++)
+			;
+		if (i == n)
+			continue;
+		len = read(fds[i], &result, sizeof(result));
+		close(fds[i]);
+		if (len == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+		{
+			stats[i] = result.stats;
+			errors += result.errors;
+		}
+		else
+		{
+			/* The worker died (e.g. the allocator crashed) */
+			memset(&stats[i], 0, sizeof(stats_t));
+			sprintf(msg, "worker for %s terminated abnormally", tracefiles[i]);
+			malloc_error(i, 0, msg);
+		}
+		for (slot = 0; slot < jobs; slot++)
+			if (slots[slot] == i + 1)
+				slots[slot] = 0;
+		running--;
+	}
+
+	free(pids);
+	free(fds);
+	free(slots);
+}
+
+/*
+ * time_trace - Time f on one trace runs times with fsecs() and store
+ *    the mean and standard deviation. A single K-best measurement
+ *    hides run-to-run noise; the spread is what lets compare_baseline
+ *    tell a real regression from an unlucky run.
+ */
+static double time_trace(fsecs_test_funct f, speed_t *speed_params,
+						 int runs, stats_t *stats)
+{
+	double sample[MAXRUNS];
+	double sum = 0, sq = 0;
+	int r;
+
+	for (r = 0; r < runs; r++)
+	{
+		sample[r] = fsecs(f, speed_params);
+		sum += sample[r];
+	}
+	stats->runs = runs;
+	stats->secs = sum / runs;
+	for (r = 0; r < runs; r++)
+		sq += (sample[r] - stats->secs) * (sample[r] - stats->secs);
+	stats->secs_sd = runs > 1 ? sqrt(sq / (runs - 1)) : 0;
+	return stats->secs;
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -878,7 +1904,7 @@ static void eval_mm_speed(void *ptr)
  */
 static int eval_libc_valid(trace_t *trace, int tracenum)
 {
-	int i, newsize;
+	int i, j, newsize;
 	char *p, *newp, *oldp;
 
 	for (i = 0; i < trace->num_ops; i++)
@@ -895,6 +1921,25 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 			trace->blocks[trace->ops[i].index] = p;
 			break;
 
+		case CALLOC: /* calloc */
+			if ((p = calloc(1, trace->ops[i].size)) == NULL)
+			{
+				malloc_error(tracenum, i, "libc calloc failed");
+				unix_error("System message");
+			}
+			trace->blocks[trace->ops[i].index] = p;
+			break;
+
+		case MEMALIGN: /* posix_memalign */
+			if (posix_memalign((void **)&p, LIBC_ALIGN(trace->ops[i].align),
+							   trace->ops[i].size) != 0)
+			{
+				malloc_error(tracenum, i, "libc posix_memalign failed");
+				unix_error("System message");
+			}
+			trace->blocks[trace->ops[i].index] = p;
+			break;
+
 		case REALLOC: /* realloc */
 			newsize = trace->ops[i].size;
 			oldp = trace->blocks[trace->ops[i].index];
@@ -910,6 +1955,23 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 			free(trace->blocks[trace->ops[i].index]);
 			break;
 
+		case ALLOC_BATCH: /* one malloc per block */
+			for (j = 0; j < trace->ops[i].count; j++)
+			{
+				if ((p = malloc(trace->ops[i].size)) == NULL)
+				{
+					malloc_error(tracenum, i, "libc malloc failed");
+					unix_error("System message");
+				}
+				trace->blocks[trace->ops[i].index + j] = p;
+			}
+			break;
+
+		case FREE_BATCH: /* one free per block */
+			for (j = 0; j < trace->ops[i].count; j++)
+				free(trace->blocks[trace->ops[i].index + j]);
+			break;
+
 		default:
 			app_error("invalid operation type  in eval_libc_valid");
 		}
@@ -925,7 +1987,7 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
  */
 static void eval_libc_speed(void *ptr)
 {
-	int i;
+	int i, j;
 	int index, size, newsize;
 	char *p, *newp, *oldp, *block;
 	trace_t *trace = ((speed_t *)ptr)->trace;
@@ -942,6 +2004,23 @@ static void eval_libc_speed(void *ptr)
 			trace->blocks[index] = p;
 			break;
 
+		case CALLOC: /* calloc */
+			index = trace->ops[i].index;
+			size = trace->ops[i].size;
+			if ((p = calloc(1, size)) == NULL)
+				unix_error("calloc failed in eval_libc_speed");
+			trace->blocks[index] = p;
+			break;
+
+		case MEMALIGN: /* posix_memalign */
+			index = trace->ops[i].index;
+			size = trace->ops[i].size;
+			if (posix_memalign((void **)&p, LIBC_ALIGN(trace->ops[i].align),
+							   size) != 0)
+				unix_error("posix_memalign failed in eval_libc_speed");
+			trace->blocks[index] = p;
+			break;
+
 		case REALLOC: /* realloc */
 			index = trace->ops[i].index;
 			newsize = trace->ops[i].size;
@@ -957,6 +2036,20 @@ static void eval_libc_speed(void *ptr)
 			block = trace->blocks[index];
 			free(block);
 			break;
+
+		case ALLOC_BATCH: /* one malloc per block */
+			index = trace->ops[i].index;
+			size = trace->ops[i].size;
+			for (j = 0; j < trace->ops[i].count; j++)
+				if ((trace->blocks[index + j] = malloc(size)) == NULL)
+					unix_error("malloc failed in eval_libc_speed");
+			break;
+
+		case FREE_BATCH: /* one free per block */
+			index = trace->ops[i].index;
+			for (j = 0; j < trace->ops[i].count; j++)
+				free(trace->blocks[index + j]);
+			break;
 		}
 	}
 }
@@ -972,58 +2065,397 @@ static void printresults(int n, stats_t *stats)
 {
 	int i;
 	double secs = 0;
+	double var = 0; /* of the total secs, with -r */
 	double ops = 0;
 	double util = 0;
 
 	/* Print the individual results for each trace */
-	printf("%5s%7s %5s%8s%10s%6s\n",
-		   "trace", " valid", "util", "ops", "secs", "Kops");
+	printf("%5s%7s %5s%8s%10s",
+		   "trace", " valid", "util", "ops", "secs");
+	if (runs > 1)
+		printf("%10s", "sd");
+	printf("%6s\n", "Kops");
 	for (i = 0; i < n; i++)
 	{
 		if (stats[i].valid)
 		{
-			printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n",
+			printf("%2d%10s%5.0f%%%8.0f%10.6f",
 				   i,
 				   "yes",
 				   stats[i].util * 100.0,
 				   stats[i].ops,
-				   stats[i].secs,
-				   (stats[i].ops / 1e3) / stats[i].secs);
+				   stats[i].secs);
+			if (runs > 1)
+				printf("%10.6f", stats[i].secs_sd);
+			printf("%6.0f\n", (stats[i].ops / 1e3) / stats[i].secs);
 			secs += stats[i].secs;
+			var += stats[i].secs_sd * stats[i].secs_sd;
 			ops += stats[i].ops;
 			util += stats[i].util;
 		}
 		else
 		{
-			printf("%2d%10s%6s%8s%10s%6s\n",
+			printf("%2d%10s%6s%8s%10s",
 				   i,
 				   "no",
 				   "-",
 				   "-",
-				   "-",
 				   "-");
+			if (runs > 1)
+				printf("%10s", "-");
+			printf("%6s\n", "-");
 		}
 	}
 
 	/* Print the aggregate results for the set of traces */
 	if (errors == 0)
 	{
-		printf("%12s%5.0f%%%8.0f%10.6f%6.0f\n",
+		printf("%12s%5.0f%%%8.0f%10.6f",
 			   "Total       ",
 			   (util / n) * 100.0,
 			   ops,
-			   secs,
-			   (ops / 1e3) / secs);
+			   secs);
+		if (runs > 1)
+			printf("%10.6f", sqrt(var));
+		printf("%6.0f\n", (ops / 1e3) / secs);
 	}
 	else
 	{
-		printf("%12s%6s%8s%10s%6s\n",
+		printf("%12s%6s%8s%10s",
 			   "Total       ",
 			   "-",
 			   "-",
-			   "-",
 			   "-");
+		if (runs > 1)
+			printf("%10s", "-");
+		printf("%6s\n", "-");
+	}
+}
+
+/*
+ * printlatency - prints the per-op latency percentiles gathered by -L
+ */
+static void printlatency(int n, stats_t *stats)
+{
+	static const char *opnames[NUM_OPTYPES] = {"malloc", "free", "realloc", "calloc",
+											   "memalign", "mbatch", "fbatch"};
+	int i, type;
+
+	printf("%5s %-8s%8s%9s%9s%9s%10s\n",
+		   "trace", "op", "count", "p50", "p99", "p99.9", "max");
+	for (i = 0; i < n; i++)
+	{
+		if (!stats[i].valid)
+		{
+			printf("%2d%4s%-8s%8s%9s%9s%9s%10s\n",
+				   i, "", "-", "-", "-", "-", "-", "-");
+			continue;
+		}
+		for (type = 0; type < NUM_OPTYPES; type++)
+		{
+			if (stats[i].lat[type].count == 0)
+				continue;
+			printf("%2d%4s%-8s%8.0f%9.0f%9.0f%9.0f%10.0f\n",
+				   i, "",
+				   opnames[type],
+				   stats[i].lat[type].count,
+				   stats[i].lat[type].p50,
+				   stats[i].lat[type].p99,
+				   stats[i].lat[type].p999,
+				   stats[i].lat[type].max);
+		}
+	}
+}
+
+/*
+ * printcounters - prints the hardware event rates gathered by -P,
+ *    normalized per op, next to the throughput so that a speedup can
+ *    be attributed to fewer instructions or to fewer misses
+ */
+static void printcounters(int n, stats_t *stats)
+{
+	int i, e;
+
+	printf("%5s%7s%7s", "trace", "Kops", "IPC");
+	for (e = 0; e < PERFCTR_NEVENTS; e++)
+		printf("%10s", perfctr_name(e));
+	printf("\n");
+	for (i = 0; i < n; i++)
+	{
+		if (!stats[i].valid)
+		{
+			printf("%2d%10s\n", i, "-");
+			continue;
+		}
+		printf("%2d%10.0f", i, (stats[i].ops / 1e3) / stats[i].secs);
+		if (stats[i].pmc[PC_CYCLES] > 0 && stats[i].pmc[PC_INSTRUCTIONS] >= 0)
+			printf("%7.2f",
+				   stats[i].pmc[PC_INSTRUCTIONS] / stats[i].pmc[PC_CYCLES]);
+		else
+			printf("%7s", "-");
+		for (e = 0; e < PERFCTR_NEVENTS; e++)
+		{
+			if (stats[i].pmc[e] >= 0)
+				printf("%10.2f", stats[i].pmc[e] / stats[i].ops);
+			else
+				printf("%10s", "-");
+		}
+		printf("\n");
+	}
+}
+
+/*****************************************************************
+ * The following routines write the results in machine-readable form
+ * and compare them against a baseline saved by an earlier run.
+ ****************************************************************/
+
+static const char *latnames[NUM_OPTYPES] = {"malloc", "free", "realloc", "calloc",
+											"memalign", "mbatch", "fbatch"};
+
+/*
+ * write_csv - write one line per trace. The header names every column,
+ *     so read_baseline can find the ones it needs even if more are
+ *     added later.
+ */
+static void write_csv(char *filename, char **tracefiles, int n,
+					  stats_t *stats, int latency)
+{
+	FILE *fp;
+	int i, type;
+
+	if ((fp = fopen(filename, "w")) == NULL)
+	{
+		sprintf(msg, "Could not open %s in write_csv", filename);
+		unix_error(msg);
+	}
+
+	fprintf(fp, "trace,valid,ops,runs,secs,secs_sd,kops,util,heap");
+	if (latency)
+		for (type = 0; type < NUM_OPTYPES; type++)
+			fprintf(fp, ",%s_p50,%s_p99,%s_p999,%s_max", latnames[type],
+					latnames[type], latnames[type], latnames[type]);
+	fprintf(fp, "\n");
+
+	for (i = 0; i < n; i++)
+	{
+		fprintf(fp, "%s,%d,%.0f,%d", tracefiles[i], stats[i].valid,
+				stats[i].ops, stats[i].runs);
+		if (stats[i].valid)
+			fprintf(fp, ",%.9f,%.9f,%.3f,%.6f,%.0f", stats[i].secs,
+					stats[i].secs_sd, (stats[i].ops / 1e3) / stats[i].secs,
+					stats[i].util, stats[i].heap);
+		else
+			fprintf(fp, ",,,,,");
+		if (latency)
+			for (type = 0; type < NUM_OPTYPES; type++)
+				fprintf(fp, ",%.0f,%.0f,%.0f,%.0f", stats[i].lat[type].p50,
+						stats[i].lat[type].p99, stats[i].lat[type].p999,
+						stats[i].lat[type].max);
+		fprintf(fp, "\n");
+	}
+	fclose(fp);
+}
+
+/*
+ * write_json - write the results as one JSON object with a "traces"
+ *     array. Trace names come from the command line or config.h and
+ *     never contain characters that need escaping.
+ */
+static void write_json(char *filename, char **tracefiles, int n,
+					   stats_t *stats, int latency, double perfindex)
+{
+	FILE *fp;
+	int i, type;
+
+	if ((fp = fopen(filename, "w")) == NULL)
+	{
+		sprintf(msg, "Could not open %s in write_json", filename);
+		unix_error(msg);
+	}
+
+	fprintf(fp, "{\n  \"errors\": %d,\n  \"perfindex\": %.2f,\n",
+			errors, perfindex);
+	fprintf(fp, "  \"traces\": [\n");
+	for (i = 0; i < n; i++)
+	{
+		fprintf(fp, "    {\"trace\": \"%s\", \"valid\": %s, \"ops\": %.0f",
+				tracefiles[i], stats[i].valid ? "true" : "false", stats[i].ops);
+		if (stats[i].valid)
+		{
+			fprintf(fp, ", \"runs\": %d, \"secs\": %.9f, \"secs_sd\": %.9f",
+					stats[i].runs, stats[i].secs, stats[i].secs_sd);
+			fprintf(fp, ", \"kops\": %.3f, \"util\": %.6f, \"heap\": %.0f",
+					(stats[i].ops / 1e3) / stats[i].secs, stats[i].util,
+					stats[i].heap);
+			if (latency)
+			{
+				fprintf(fp, ",\n     \"latency\": {");
+				for (type = 0; type < NUM_OPTYPES; type++)
+					fprintf(fp, "%s\"%s\": {\"count\": %.0f, \"p50\": %.0f, "
+								"\"p99\": %.0f, \"p999\": %.0f, \"max\": %.0f}",
+							type ? ", " : "", latnames[type],
+							stats[i].lat[type].count, stats[i].lat[type].p50,
+							stats[i].lat[type].p99, stats[i].lat[type].p999,
+							stats[i].lat[type].max);
+				fprintf(fp, "}");
+			}
+		}
+		fprintf(fp, "}%s\n", i < n - 1 ? "," : "");
+	}
+	fprintf(fp, "  ]\n}\n");
+	fclose(fp);
+}
+
+/*
+ * t_critical - two-sided 95% critical value of Student's t
+ */
+static double t_critical(double df)
+{
+	static const double t95[30] = {
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+	if (df < 1)
+		df = 1;
+	if (df <= 30)
+		return t95[(int)df - 1];
+	if (df <= 60)
+		return 2.000;
+	if (df <= 120)
+		return 1.980;
+	return 1.960;
+}
+
+/*
+ * csv_field - return field col of a comma-separated line (copied
+ *     into buf), or NULL if the line is shorter
+ */
+static char *csv_field(char *line, int col, char *buf)
+{
+	char *end;
+
+	while (col-- > 0)
+	{
+		if ((line = strchr(line, ',')) == NULL)
+			return NULL;
+		line++;
+	}
+	end = line + strcspn(line, ",\r\n");
+	memcpy(buf, line, end - line);
+	buf[end - line] = '\0';
+	return buf;
+}
+
+/*
+ * compare_baseline - compare the results of this run with a CSV file
+ *     written by -C. Traces are matched by name. Throughput is compared
+ *     with Welch's t-test on the per-run times, so both runs need -r 2
+ *     or more for a verdict; a trace is flagged only when the slowdown
+ *     is significant at 95% and larger than REGRESS_MIN. Utilization is
+ *     deterministic, so any drop is flagged. Returns the number of
+ *     flagged traces.
+ */
+static int compare_baseline(char *filename, char **tracefiles, int n,
+							stats_t *stats)
+{
+	static const char *cols[] = {"trace", "runs", "secs", "secs_sd", "util"};
+	int col[5];
+	FILE *fp;
+	char line[MAXLINE], field[MAXLINE], buf[MAXLINE];
+	int i, k, flagged = 0, found;
+	double b_runs, b_secs, b_sd, b_util, se, t, df, change;
+	char *verdict;
+
+	if ((fp = fopen(filename, "r")) == NULL)
+	{
+		sprintf(msg, "Could not open %s in compare_baseline", filename);
+		unix_error(msg);
+	}
+
+	/* Locate the columns we need in the header */
+	if (fgets(line, MAXLINE, fp) == NULL)
+		app_error("Empty baseline file");
+	for (k = 0; k < 5; k++)
+	{
+		col[k] = -1;
+		for (i = 0; csv_field(line, i, field) != NULL; i++)
+			if (!strcmp(field, cols[k]))
+				col[k] = i;
+		if (col[k] < 0)
+		{
+			sprintf(msg, "Baseline %s has no \"%s\" column", filename, cols[k]);
+			app_error(msg);
+		}
+	}
+
+	printf("Comparison against baseline %s:\n", filename);
+	printf("%-20s%10s%10s%8s%8s%8s%8s  %s\n", "trace", "base Kops", "Kops",
+		   "change", "t", "b.util", "util", "verdict");
+	for (i = 0; i < n; i++)
+	{
+		/* Find this trace in the baseline */
+		rewind(fp);
+		fgets(line, MAXLINE, fp);
+		found = 0;
+		while (fgets(line, MAXLINE, fp) != NULL)
+		{
+			if (csv_field(line, col[0], field) != NULL &&
+				!strcmp(field, tracefiles[i]) &&
+				csv_field(line, col[2], buf) != NULL && buf[0] != '\0')
+			{
+				found = 1;
+				break;
+			}
+		}
+		if (!found || !stats[i].valid)
+		{
+			printf("%-20s%10s%10s%8s%8s%8s%8s  %s\n", tracefiles[i],
+				   "-", "-", "-", "-", "-", "-",
+				   found ? "invalid" : "not in baseline");
+			continue;
+		}
+		b_runs = atof(csv_field(line, col[1], buf));
+		b_secs = atof(csv_field(line, col[2], buf));
+		b_sd = atof(csv_field(line, col[3], buf));
+		b_util = atof(csv_field(line, col[4], buf));
+
+		/* Welch's t statistic and degrees of freedom */
+		change = stats[i].secs / b_secs - 1.0;
+		t = 0;
+		verdict = "ok";
+		if (b_runs >= 2 && stats[i].runs >= 2)
+		{
+			se = b_sd * b_sd / b_runs +
+				 stats[i].secs_sd * stats[i].secs_sd / stats[i].runs;
+			if (se > 0)
+			{
+				t = (stats[i].secs - b_secs) / sqrt(se);
+				df = se * se /
+					 (pow(b_sd * b_sd / b_runs, 2) / (b_runs - 1) +
+					  pow(stats[i].secs_sd * stats[i].secs_sd / stats[i].runs, 2) /
+						  (stats[i].runs - 1));
+				if (t > t_critical(df) && change > REGRESS_MIN)
+					verdict = "SLOWER";
+				else if (-t > t_critical(df) && -change > REGRESS_MIN)
+					verdict = "faster";
+			}
+		}
+		else
+			verdict = "need -r >= 2";
+		if (stats[i].util < b_util - 5e-7)
+			verdict = strcmp(verdict, "SLOWER") ? "LESS UTIL" : "SLOWER, LESS UTIL";
+		if (!strncmp(verdict, "SLOWER", 6) || !strcmp(verdict, "LESS UTIL"))
+			flagged++;
+
+		printf("%-20s%10.0f%10.0f%+7.1f%%%8.2f%7.1f%%%7.1f%%  %s\n",
+			   tracefiles[i], (stats[i].ops / 1e3) / b_secs,
+			   (stats[i].ops / 1e3) / stats[i].secs, change * 100.0, t,
+			   b_util * 100.0, stats[i].util * 100.0, verdict);
 	}
+	fclose(fp);
+	printf("%d trace(s) regressed\n", flagged);
+	return flagged;
 }
 
 /*
@@ -1058,13 +2490,31 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void)
 {
-	fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+	fprintf(stderr, "Usage: mdriver [-hvValLPSH] [-f <file>] [-t <dir>] [-k <K>] [-e <eps>] [-s <n>]\n"
+					"               [-r <n>] [-C <csv>] [-J <json>] [-b <csv>] [-j <n>] [-F <n>]\n"
+					"               [-D <n>] [-p <bytes>] [-c <n>]\n");
 	fprintf(stderr, "Options\n");
 	fprintf(stderr, "\t-a         Don't check the team structure.\n");
+	fprintf(stderr, "\t-b <csv>   Compare with a baseline saved by -C; exit 2 on regression.\n");
+	fprintf(stderr, "\t-c <n>     Check the heap after every op, in full every <n> ops.\n");
+	fprintf(stderr, "\t-C <csv>   Write per-trace results as CSV.\n");
+	fprintf(stderr, "\t-D <n>     Purge free pages idle for <n> ops (-1: never).\n");
+	fprintf(stderr, "\t-e <eps>   K-best timing tolerance (default 0.01).\n");
 	fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+	fprintf(stderr, "\t-F <n>     Write <trace>.frag.csv, sampling the heap and RSS every <n> ops.\n");
 	fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
 	fprintf(stderr, "\t-h         Print this message.\n");
+	fprintf(stderr, "\t-H         Pass lifetimes predicted from the trace as allocation hints.\n");
+	fprintf(stderr, "\t-j <n>     Evaluate up to <n> traces at once in worker processes.\n");
+	fprintf(stderr, "\t-J <json>  Write per-trace results as JSON.\n");
+	fprintf(stderr, "\t-k <K>     K in the K-best timing scheme (default 3).\n");
 	fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+	fprintf(stderr, "\t-L         Report per-op latency percentiles.\n");
+	fprintf(stderr, "\t-p <bytes> Write <trace>.heap, sampling a stack every <bytes> allocated.\n");
+	fprintf(stderr, "\t-P         Report hardware performance counters.\n");
+	fprintf(stderr, "\t-r <n>     Time each trace <n> times; report mean secs and their sd.\n");
+	fprintf(stderr, "\t-S         Free through mm_free_sized, passing the block's size.\n");
+	fprintf(stderr, "\t-s <n>     K-best timing gives up after <n> runs (default 20).\n");
 	fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
 	fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
 	fprintf(stderr, "\t-V         Print additional debug info.\n");
@@ -0,0 +1,223 @@
+/*
+ * memcopy.c - vectorized block copy with a non-temporal path
+ *
+ * Each implementation copies the first and last vector of the block
+ * with unaligned accesses and everything in between, four vectors at
+ * a time, with stores to aligned addresses. Below the non-temporal
+ * threshold the stores go through the cache; above it they stream
+ * past it, followed by an sfence so the copy is complete before the
+ * caller frees the source.
+ */
+#include <string.h>
+#include <unistd.h>
+#include "memcopy.h"
+
+#define SHORT_COPY 256           /* shorter copies go to libc memcpy */
+#define DEFAULT_NT (4 << 20)     /* threshold if the cache size is unknown */
+
+typedef void (*copy_funct)(char *dst, const char *src, size_t n);
+
+static int inited = 0;
+static size_t nt_threshold;      /* copies this long bypass the cache */
+static copy_funct copy;          /* implementation in use ... */
+static const char *copy_name;    /* ... and its name */
+
+static void copy_libc(char *dst, const char *src, size_t n)
+{
+    memcpy(dst, src, n);
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+
+/*
+ * DEFINE_COPY - Define the copy routine name for vectors of type vec,
+ *     W bytes wide, using the instruction set isa. Needs n >= 4 * W.
+ */
+#define DEFINE_COPY(name, isa, vec, W, loadu, storeu, store, stream)	\
+__attribute__((target(isa)))						\
+static void name(char *dst, const char *src, size_t n)			\
+{									\
+    char *end = dst + n;						\
+    char *d = dst + W - ((size_t)dst & (W - 1));			\
+    const char *s = src + (d - dst);					\
+    vec head = loadu((const vec *)src);					\
+    vec tail = loadu((const vec *)(src + n - W));			\
+    vec v0, v1, v2, v3;							\
+									\
+    if (n >= nt_threshold) {						\
+	for (; d + 4 * W <= end; d += 4 * W, s += 4 * W) {		\
+	    v0 = loadu((const vec *)s);					\
+	    v1 = loadu((const vec *)(s + W));				\
+	    v2 = loadu((const vec *)(s + 2 * W));			\
+	    v3 = loadu((const vec *)(s + 3 * W));			\
+	    stream((vec *)d, v0);					\
+	    stream((vec *)(d + W), v1);					\
+	    stream((vec *)(d + 2 * W), v2);				\
+	    stream((vec *)(d + 3 * W), v3);				\
+	}								\
+	_mm_sfence();							\
+    } else {								\
+	for (; d + 4 * W <= end; d += 4 * W, s += 4 * W) {		\
+	    v0 = loadu((const vec *)s);					\
+	    v1 = loadu((const vec *)(s + W));				\
+	    v2 = loadu((const vec *)(s + 2 * W));			\
+	    v3 = loadu((const vec *)(s + 3 * W));			\
+	    store((vec *)d, v0);					\
+	    store((vec *)(d + W), v1);					\
+	    store((vec *)(d + 2 * W), v2);				\
+	    store((vec *)(d + 3 * W), v3);				\
+	}								\
+    }									\
+    for (; d + W <= end; d += W, s += W)				\
+	store((vec *)d, loadu((const vec *)s));				\
+    storeu((vec *)(end - W), tail);					\
+    storeu((vec *)dst, head);						\
+}
+
+DEFINE_COPY(copy_sse2, "sse2", __m128i, 16, _mm_loadu_si128,
+	    _mm_storeu_si128, _mm_store_si128, _mm_stream_si128)
+DEFINE_COPY(copy_avx2, "avx2", __m256i, 32, _mm256_loadu_si256,
+	    _mm256_storeu_si256, _mm256_store_si256, _mm256_stream_si256)
+DEFINE_COPY(copy_avx512, "avx512f", __m512i, 64, _mm512_loadu_si512,
+	    _mm512_storeu_si512, _mm512_store_si512, _mm512_stream_si512)
+
+/*
+ * os_saves - Does the OS save and restore the register state in mask
+ *     (XCR0 bits) across context switches?
+ */
+static int os_saves(unsigned long long mask)
+{
+    unsigned lo, hi;
+
+    asm volatile("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+    return ((((unsigned long long)hi << 32) | lo) & mask) == mask;
+}
+
+/*
+ * cpu_supports - Can this CPU, under this OS, run the named copy?
+ */
+static int cpu_supports(const char *name)
+{
+    unsigned a, b, c, d;
+
+    if (!strcmp(name, "libc"))
+	return 1;
+    if (!__get_cpuid(1, &a, &b, &c, &d))
+	return 0;
+    if (!strcmp(name, "sse2"))
+	return (d >> 26) & 1;
+    if (!(c & (1u << 27)))                 /* no OSXSAVE, so no xgetbv */
+	return 0;
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+	return 0;
+    if (!strcmp(name, "avx2"))
+	return (b & (1u << 5)) && os_saves(0x6);      /* XMM, YMM */
+    if (!strcmp(name, "avx512"))
+	return (b & (1u << 16)) && os_saves(0xe6);    /* ... and ZMM, k */
+    return 0;
+}
+#else
+static int cpu_supports(const char *name)
+{
+    return !strcmp(name, "libc");
+}
+#endif
+
+/* Implementations, best first */
+static const struct {
+    const char *name;
+    copy_funct fn;
+} impls[] = {
+#if defined(__i386__) || defined(__x86_64__)
+    {"avx512", copy_avx512},
+    {"avx2", copy_avx2},
+    {"sse2", copy_sse2},
+#endif
+    {"libc", copy_libc},
+    {NULL, NULL}
+};
+
+/*
+ * memcopy_init - Pick the best implementation this CPU supports and
+ *     derive the non-temporal threshold from the private L2. A copy of
+ *     twice the L2 has flushed it whatever the stores do, and that is
+ *     about where copybench sees streaming stores pull ahead; the
+ *     shared L3 is no guide, as other cores are competing for it.
+ */
+static void memcopy_init(void)
+{
+    long cache = -1;
+    int i;
+
+    inited = 1;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    cache = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    nt_threshold = cache > 0 ? 2 * (size_t)cache : DEFAULT_NT;
+    for (i = 0; impls[i].name != NULL; i++)
+	if (cpu_supports(impls[i].name))
+	    break;
+    copy = impls[i].fn;
+    copy_name = impls[i].name;
+}
+
+/*
+ * memcopy - Copy n bytes from src to dst
+ */
+void *memcopy(void *dst, const void *src, size_t n)
+{
+    if (!inited)
+	memcopy_init();
+    if (n < SHORT_COPY)
+	return memcpy(dst, src, n);
+    copy((char *)dst, (const char *)src, n);
+    return dst;
+}
+
+/*
+ * memcopy_impl - Name of the implementation in use
+ */
+const char *memcopy_impl(void)
+{
+    if (!inited)
+	memcopy_init();
+    return copy_name;
+}
+
+/*
+ * memcopy_select - Force an implementation by name
+ */
+int memcopy_select(const char *name)
+{
+    int i;
+
+    if (!inited)
+	memcopy_init();
+    for (i = 0; impls[i].name != NULL; i++)
+	if (!strcmp(impls[i].name, name))
+	    break;
+    if (impls[i].name == NULL || !cpu_supports(name))
+	return -1;
+    copy = impls[i].fn;
+    copy_name = impls[i].name;
+    return 0;
+}
+
+/*
+ * memcopy_nt/memcopy_set_nt - Get and set the non-temporal threshold
+ */
+size_t memcopy_nt(void)
+{
+    if (!inited)
+	memcopy_init();
+    return nt_threshold;
+}
+
+void memcopy_set_nt(size_t bytes)
+{
+    if (!inited)
+	memcopy_init();
+    nt_threshold = bytes;
+}
@@ -0,0 +1,32 @@
+/*
+ * memcopy.h - block copy for moving large allocations
+ *
+ * memcopy copies with the widest vector unit the CPU and OS support
+ * (AVX-512, AVX2 or SSE2, picked once with CPUID). Copies of at least
+ * the non-temporal threshold use streaming stores, so that moving a
+ * big block does not evict the rest of the working set; by default
+ * the threshold is twice the L2 cache. Short copies go to libc memcpy.
+ * The regions must not overlap.
+ */
+#ifndef __MEMCOPY_H_
+#define __MEMCOPY_H_
+
+#include <stddef.h>
+
+/* Copy n bytes from src to dst and return dst */
+void *memcopy(void *dst, const void *src, size_t n);
+
+/* Name of the implementation in use: "avx512", "avx2", "sse2" or "libc" */
+const char *memcopy_impl(void);
+
+/*
+ * Force an implementation by name, for benchmarking. Returns 0, or -1
+ * if this CPU cannot run it.
+ */
+int memcopy_select(const char *name);
+
+/* Get and set the size from which copies use non-temporal stores */
+size_t memcopy_nt(void);
+void memcopy_set_nt(size_t bytes);
+
+#endif /* __MEMCOPY_H_ */
@@ -18,20 +18,28 @@
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static char *mem_hiwater;    /* highest brk ever; the heap above is untouched */
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
-    /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
-	fprintf(stderr, "mem_init_vm: malloc error\n");
+    /*
+     * allocate the storage we will use to model the available VM. Like
+     * the pages a real sbrk hands out, anonymous mappings read as zero
+     * until they are first written.
+     */
+    mem_start_brk = (char *)mmap(NULL, MAX_HEAP, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem_start_brk == (char *)MAP_FAILED) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
 	exit(1);
     }
 
     mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_hiwater = mem_start_brk;
 }
 
 /* 
@@ -39,7 +47,7 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    munmap(mem_start_brk, MAX_HEAP);
 }
 
 /*
@@ -65,6 +73,8 @@ void *mem_sbrk(int incr)
 	return (void *)-1;
     }
     mem_brk += incr;
+    if (mem_brk > mem_hiwater)
+	mem_hiwater = mem_brk;
     return (void *)old_brk;
 }
 
@@ -84,6 +94,16 @@ void *mem_heap_hi()
     return (void *)(mem_brk - 1);
 }
 
+/*
+ * mem_heap_fresh - return the high-water mark of the brk pointer. The
+ *    heap from there up has never been handed out by mem_sbrk, even
+ *    across mem_reset_brk, so it still reads as zero.
+ */
+void *mem_heap_fresh()
+{
+    return (void *)mem_hiwater;
+}
+
 /*
  * mem_heapsize() - returns the heap size in bytes
  */
@@ -99,3 +119,29 @@ size_t mem_pagesize()
 {
     return (size_t)getpagesize();
 }
+
+/*
+ * mem_purge - give the n bytes of whole pages at p back to the OS, as
+ *    a real allocator would with madvise. They stay in the heap and
+ *    read as zero when next touched. Returns 0, or -1 on error.
+ */
+int mem_purge(void *p, size_t n)
+{
+    return madvise(p, n, MADV_DONTNEED);
+}
+
+/*
+ * mem_resident - return the number of heap bytes resident in memory
+ */
+size_t mem_resident()
+{
+    static unsigned char vec[MAX_HEAP / 4096 + 1];
+    size_t page = mem_pagesize();
+    size_t n = (mem_heapsize() + page - 1) / page, i, res = 0;
+
+    if (n == 0 || n > sizeof(vec) || mincore(mem_start_brk, n * page, vec) < 0)
+	return 0;
+    for (i = 0; i < n; i++)
+	res += vec[i] & 1;
+    return res * page;
+}
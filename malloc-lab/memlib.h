@@ -6,6 +6,9 @@ void *mem_sbrk(int incr);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
+void *mem_heap_fresh(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
+int mem_purge(void *p, size_t n);
+size_t mem_resident(void);
 
@@ -1,22 +1,117 @@
 /*
- * mm-naive.c - The fastest, least memory-efficient malloc package.
+ * mm.c - segregated free lists with boundary tags.
  *
- * In this naive approach, a block is allocated by simply incrementing
- * the brk pointer.  A block is pure payload. There are no headers or
- * footers.  Blocks are never coalesced or reused. Realloc is
- * implemented directly using mm_malloc and mm_free.
+ * Every block has a 4-byte header and footer holding its size and
+ * allocation bit; blocks are 8-byte aligned and at least 16 bytes.
+ * Free blocks also hold two 4-byte links, the offsets from the start
+ * of the heap of their predecessor and successor in a free list (0
+ * ends a list), so the minimum block stays at 16 bytes.
  *
- * NOTE TO STUDENTS: Replace this header comment with your own header
- * comment that gives a high level description of your solution.
+ * Small blocks use the size classes of mm_classes.h, which are fitted
+ * to a set of traces by traces/gen_sizeclass ("make classes"). A
+ * request is rounded up to its class with one table lookup, and a
+ * free block goes on the list of the largest class it can hold, so
+ * the head of the list of a request's class always fits it. Blocks
+ * above MM_CLASS_MAXBLOCK go on power-of-two lists searched first-fit.
+ * Freed blocks are coalesced immediately.
+ *
+ * The heap is a sequence of spans, runs of whole pages described in the
+ * page map (pagemap.h) and handed out by the page heap (pageheap.h):
+ * segments of boundary-tag blocks, each with its own prologue and
+ * epilogue; slabs of headerless objects of one size class, for
+ * requests up to SLAB_MAX bytes; large spans that each hold one request
+ * of LARGE_MIN bytes or more; and free runs. mm_free looks the pointer
+ * up in the page map to tell them apart, without reading the heap.
+ * Empty slabs and freed large spans go back to the page heap, where
+ * they merge with free neighbors and are reused by any kind of span. A
+ * segment that ends the heap grows in place, by the byte.
+ *
+ * mm_calloc avoids clearing memory that is already zero: everything
+ * above fresh_lo has never held a payload, and the allocator scrubs
+ * its own boundary tags, links and decay words there when blocks merge,
+ * so such a block only needs its first 16 bytes (the old links and
+ * decay words) cleared.
+ *
+ * mm_memalign places the payload of an ordinary block on the requested
+ * boundary. It looks for a free block with an aligned address far
+ * enough in to leave room for a free block in front of it, or exactly
+ * at its start; the leading gap and the tail both go back on the free
+ * lists, so an aligned block costs no more than its size.
+ *
+ * mm_malloc_batch carves a run of same-sized blocks out of one free
+ * block, and mm_free_batch sorts the blocks it frees by address so
+ * that each run of neighbors is merged into one free block and
+ * coalesced once.
+ *
+ * mm_free_sized takes the size the block was requested with, which
+ * says whether it is a slab object, block or large span. A block is
+ * freed without the page map lookup, and when its header holds exactly
+ * the class size the request implies (cut to its class, never grown)
+ * without decoding the header either; anything else takes the mm_free
+ * path. Compile with -DMM_CHECK_SIZED to abort on a size the block
+ * cannot hold.
+ *
+ * mm_malloc_hint cuts a block hinted to be long-lived from the high end
+ * of the free block it fits in, and an ordinary one from the low end.
+ * Long-lived blocks then gather at the tops of free regions, and the
+ * space that short-lived blocks leave when they go is not broken up by
+ * one that stays.
+ *
+ * Free memory decays. Allocations and frees advance a clock, and
+ * every DECAY_PASS ticks the page heap purges the runs that have been
+ * free for more than the decay interval (mm_set_decay), so memory
+ * freed in a busy phase goes back to the OS in a quiet one. Free blocks
+ * of PURGE_MIN bytes or more in segments decay too: the pass purges
+ * the whole pages inside them. Such a block keeps the tick it was freed
+ * at and how many of its bytes are purged in the two words after its
+ * links. When it is split or merged, its purged bytes pass to what
+ * stays free, and the rest count as refaulted.
+ *
+ * mm_stats reports the heap's occupancy from counters that the code
+ * changing it keeps current (tally): the free lists count their blocks
+ * and bytes, and segment growth, slabs and large spans their bytes.
+ * The allocator is single-threaded, so the counters are plain words.
+ *
+ * A sampling profiler (heapprof.h) records the stack of about one
+ * allocation in every mm_prof_start rate bytes. Each allocation entry
+ * point counts its bytes down with SAMPLE, and each free checks the
+ * profiler's filter with UNSAMPLE, so profiling costs nothing else
+ * between samples.
+ *
+ * mm_check verifies the heap. A full check walks every span, block and
+ * free list. An incremental check looks only at the blocks logged since
+ * the last check, and their neighbors. MARK and UNMARK log every block
+ * that appears or goes, and TOUCH every one whose size changes in
+ * place, so together they cover every tag change. The log is kept
+ * once the first incremental check has been asked for, and costs one
+ * flag test per tag change otherwise.
+ *
+ * Compiled with -DMM_BITMAP, the allocator also keeps the block starts
+ * and allocation bits of every segment in side bitmaps (blockmap.h).
+ * coalesce then learns whether the next block is free from the bitmap
+ * and reads its header only to merge it; the previous block's footer
+ * sits next to the freed block's own header and is read as before.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
+#include "memcopy.h"
+#include "pagemap.h"
+#include "pageheap.h"
+#include "mm_classes.h"
+#include "heapprof.h"
+#ifdef MM_BITMAP
+#include "blockmap.h"
+#endif
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -41,7 +136,15 @@ team_t team = {
 #define DSIZE 8
 #define CHUNKSIZE (1 << 12)
 
+/* The growth chunk doubles, up to GROW_MAX, every GROW_STREAK times the
+   heap grows with no more than GROW_IDLE ticks in between, and drops
+   back to CHUNKSIZE when it has not grown for longer */
+#define GROW_MAX (1 << 14)
+#define GROW_IDLE 256
+#define GROW_STREAK 16
+
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
 
 /* Pack a size and allocation flag into a single word */
 #define PACK(size, alloc) ((size) | (alloc))
@@ -54,6 +157,10 @@ team_t team = {
 #define GET_SIZE(p) (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
 
+/* Header bit of an allocated block that has been grown by realloc */
+#define GROWN 0x2
+#define GET_GROWN(p) (GET(p) & GROWN)
+
 /* Given block ptr bp, compute address of its header and footer */
 #define HDRP(bp) ((char *)(bp) - WSIZE)
 #define FTRP(bp) ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
@@ -62,8 +169,82 @@ team_t team = {
 #define NEXT_BLKP(bp) ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp) ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
-#define PREV_FREE_BLKP(bp) (*(void **)(bp))
-#define NEXT_FREE_BLKP(bp) (*(void **)(bp) + WSIZE)
+/* Free-list links of free block bp, as heap offsets (0 for none) */
+#define PRED(bp) (*(unsigned int *)(bp))
+#define SUCC(bp) (*((unsigned int *)(bp) + 1))
+
+/* Free blocks this big decay: the tick they were freed at and the bytes
+   of their inside that are purged follow the links */
+#define PURGE_MIN (2 * PM_PAGE)
+#define IDLE(bp) (*((unsigned int *)(bp) + 2))
+#define PURGED(bp) (*((unsigned int *)(bp) + 3))
+
+/* Log a block whose tags changed (start: whether it still starts a
+   block) for mm_check, once an incremental check has been asked for */
+#define TOUCH(bp, start) do { if (touch_on) touch(bp, start); } while (0)
+#define TOUCH_MAX 4096
+
+/* Record block starts in the side bitmaps, or forget them */
+#ifdef MM_BITMAP
+#define MARK(bp, alloc) do { blockmap_mark(bp, alloc); TOUCH(bp, 1); } while (0)
+#define UNMARK(bp) do { blockmap_unmark(bp); TOUCH(bp, 0); } while (0)
+#else
+#define MARK(bp, alloc) TOUCH(bp, 1)
+#define UNMARK(bp) TOUCH(bp, 0)
+#endif
+
+/* Convert between block pointers and heap offsets */
+#define TO_OFF(bp) ((unsigned int)((char *)(bp) - heap_base))
+#define TO_BLKP(off) ((off) ? heap_base + (off) : NULL)
+
+/* Grown blocks whose realloc headroom can be trimmed under pressure */
+#define NGROWN 16
+
+/* Dirty blocks at least this big are cleared with streaming stores */
+#define STREAM_CLEAR (256 * 1024)
+
+/* Power-of-two lists for blocks above the largest class */
+#define NLARGE 20
+#define NLISTS (MM_NCLASSES + NLARGE)
+#if NLISTS > MM_STATS_LISTS
+#error "mm_stats_t has too few free lists"
+#endif
+
+/* Blocks at least this big are large spans instead */
+#define LARGE_MIN (32 * 1024)
+#define IS_LARGE(asize) ((asize) >= LARGE_MIN)
+
+/* Requests up to SLAB_MAX bytes are slab objects, in classes 8 bytes apart */
+#define SLAB_MAX 64
+#define NSLABS (SLAB_MAX / ALIGNMENT)
+#define SLAB_CLASS(size) (((size) - 1) / ALIGNMENT)
+#define SLAB_OBJ(c) (((c) + 1) * ALIGNMENT)
+#define SLAB_PAGES 1
+#define SLAB_BYTES (SLAB_PAGES * PM_PAGE)
+
+/* Pages needed for n bytes, and the bytes in span s */
+#define NPAGES(n) (((n) + PM_PAGE - 1) >> PM_PAGE_SHIFT)
+#define SPAN_BYTES(s) ((s)->npages << PM_PAGE_SHIFT)
+#define SPAN_END(s) ((s)->start + SPAN_BYTES(s))
+
+/* Free runs idle for DECAY_OPS ticks are purged, checked every DECAY_PASS */
+#define DECAY_OPS (1UL << 16)
+#define DECAY_PASS 1024
+#define TICK(n) do { if ((ticks += (n)) >= next_pass) decay_pass(); } while (0)
+
+/* A block is being handed out: purged bytes no remainder took are refaulted */
+#define SETTLE() do { tally.refaulted += purged_held; purged_held = 0; } while (0)
+
+/* Profiler hooks: count allocated bytes down to the next sample, and
+   look for the sample of a freed object only if the filter says so */
+#define SAMPLE(p, size) \
+    do { if ((heapprof_left -= (long)(size)) < 0 && (p) != NULL) \
+             heapprof_sample((p), (size)); } while (0)
+#define UNSAMPLE(p) \
+    do { if (heapprof_filter[HP_SLOT(p)] != 0) heapprof_free(p); } while (0)
+
+/* One past the last heap byte */
+#define HEAP_BRK() ((char *)mem_heap_hi() + 1)
 
 /* rounds up to the nearest multiple of ALIGNMENT */
 #define ALIGN(size) (((size) + (ALIGNMENT - 1)) & ~0x7)
@@ -74,27 +255,139 @@ team_t team = {
 static void *extend_heap(size_t words);
 static void *coalesce(void *ptr);
 static void *find_fit(size_t asize);
-static void *first_fit(size_t asize);
-static void *next_fit(size_t asize);
-static void *best_fit(size_t asize);
 static void place(void *ptr, size_t size);
+static int list_index(size_t size);
+static void insert_free(void *bp);
+static void remove_free(void *bp);
+static int grow_in_place(void *bp, size_t need, size_t want);
+static void note_grown(void *bp, size_t need);
+static void forget_grown(void *bp);
+static size_t trim_grown(void);
+static void scrub(void *p, size_t n);
+static void clear_block(void *p, size_t n);
+static char *aligned_in(void *bp, size_t asize, size_t align);
+static size_t adjust_size(size_t size);
+static void *malloc_block(size_t asize);
+static void *place_high(void *bp, size_t asize);
+static size_t carve(void *bp, size_t asize, size_t n, void **out);
+static int cmp_addr(const void *a, const void *b);
+static void *new_segment(size_t size);
+static int cover_brk(span_t *s);
+static span_t *alloc_pages(size_t npages);
+static int pad_segment(void);
+static int use_span(span_t *s, int kind);
+static void *malloc_large(size_t size);
+static void *memalign_large(size_t align, size_t size);
+static void *realloc_large(span_t *s, size_t size);
+static void *slab_alloc(size_t size);
+static span_t *new_slab(int c);
+static void slab_free(span_t *s, void *bp);
+static void span_free(span_t *s, void *bp);
+static void decay_pass(void);
+static void decay_blocks(void);
+static size_t inside_pages(void *bp, char **lo);
+static size_t grow_by(size_t asize);
+static size_t shortfall(size_t asize);
+#ifdef MM_CHECK_SIZED
+static void check_sized(void *bp, size_t size);
+#endif
+static void touch(void *bp, int start);
+static int check_full(void);
+static int check_touched(void);
+static int check_block(char *bp, span_t *s);
+static span_t *segment_of(char *p);
+static char *link_blkp(unsigned int off);
+static int complain(void *p, const char *what);
+static int cmp_touch(const void *a, const void *b);
 
 static void *heap_listp;
-static void *last_bp;
+static char *heap_base;                  /* offset 0 of the free-list links */
+static unsigned int free_lists[NLISTS];  /* list heads, as heap offsets */
+
+/* Side table of grown blocks: offset and the block size last needed */
+static struct {
+    unsigned int off;
+    unsigned int need;
+} grown[NGROWN];
+static int grown_next;                   /* next slot to reuse */
+
+static char *fresh_lo;                   /* no payload has been at or above */
+
+static span_t *slabs[NSLABS];            /* slabs of each class with room */
+
+static unsigned long decay = DECAY_OPS;  /* free runs idle longer are purged */
+static unsigned long ticks;              /* the decay clock */
+static unsigned long next_pass;          /* tick of the next purge pass */
+
+/* The counters mm_stats adds up */
+static struct {
+    struct {
+        size_t blocks, bytes;
+    } lists[NLISTS];                     /* on each free list */
+    size_t seg_bytes;                    /* blocks of all segments */
+    size_t slab_bytes;                   /* slab objects handed out */
+    size_t large_bytes;                  /* large spans in use */
+    size_t extends, splits, coalesces;
+    size_t purged, refaulted;            /* pages inside free blocks */
+} tally;
+
+/* Purged bytes of the blocks just taken off the lists, until they pass
+   to a free remainder or count as refaulted */
+static size_t purged_held;
+
+/* Blocks touched since the last mm_check: heap offset, order, start */
+static unsigned long long touched[TOUCH_MAX];
+static int ntouched;
+static int touch_on;                     /* log them */
+static int touch_lost;                   /* the log overflowed */
+
+static size_t chunk;                     /* the heap grows by at least this */
+static unsigned long last_grow;          /* tick of the last growth */
+static unsigned streak;                  /* growths since the last idle spell */
 
 /*
  * mm_init - initialize the malloc package.
  */
 int mm_init(void) {
+    span_t *s;
+
+    fresh_lo = mem_heap_fresh();
+    pagemap_init(mem_heap_lo());
+    pageheap_init();
+    memset(slabs, 0, sizeof(slabs));
+    ticks = 0;
+    next_pass = DECAY_PASS;
+    chunk = CHUNKSIZE;
+    last_grow = 0;
+    streak = 0;
+    heapprof_reset();
+    memset(&tally, 0, sizeof(tally));
+    purged_held = 0;
+    touch_on = 0;
+    ntouched = 0;
+#ifdef MM_BITMAP
+    if (blockmap_init(mem_heap_lo()) < 0)
+        return -1;
+#endif
     if ((heap_listp = mem_sbrk(4 * WSIZE)) == (void *)-1)
         return -1;
+    if ((s = span_new()) == NULL)
+        return -1;
+    s->start = heap_listp;
+    s->kind = SPAN_BLOCKS;
+    if (cover_brk(s) < 0)
+        return -1;
+    heap_base = heap_listp;
+    memset(free_lists, 0, sizeof(free_lists));
+    memset(grown, 0, sizeof(grown));
+    grown_next = 0;
     PUT(heap_listp, 0);
     PUT(heap_listp + (1 * WSIZE), PACK(DSIZE, 1));
     PUT(heap_listp + (2 * WSIZE), PACK(DSIZE, 1));
     PUT(heap_listp + (3 * WSIZE), PACK(0, 1));
     heap_listp += (2 * WSIZE);
-
-    last_bp = heap_listp;
+    MARK(heap_listp, 1);
+    MARK((char *)heap_listp + DSIZE, 1);
 
     if (extend_heap(CHUNKSIZE/WSIZE) == NULL)
         return -1;
@@ -103,24 +396,35 @@ int mm_init(void) {
 }
 
 /*
- * mm_malloc - Allocate a block by incrementing the brk pointer.
- *     Always allocate a block whose size is a multiple of the alignment.
+ * mm_malloc - Allocate a slab object for a small request, a span for a
+ *     large one, and a block otherwise.
  */
 void *mm_malloc(size_t size)
 {
     size_t asize;
-    size_t extendsize;
     void *bp;
 
     /* Ignore spurious requests */
     if (size == 0)
         return NULL;
-
-    /* Adjust block size to include overhead and alignment reqs.*/
-    if (size <= DSIZE)
-        asize = 2 * DSIZE; // 최소 16바이트 (헤더 + 풋터 포함)
+    TICK(1);
+    if (size <= SLAB_MAX)
+        bp = slab_alloc(size);
+    else if (IS_LARGE(asize = adjust_size(size)))
+        bp = malloc_large(size);
     else
-        asize = ALIGN(size + SIZE_T_SIZE);
+        bp = malloc_block(asize);
+    SAMPLE(bp, size);
+    return bp;
+}
+
+/*
+ * malloc_block - Allocate a block of asize bytes from the segregated
+ *     free lists, growing the heap when nothing fits.
+ */
+static void *malloc_block(size_t asize) {
+    size_t extendsize;
+    void *bp;
 
     /* Search the free list for a fit*/
     if ((bp = find_fit(asize)) != NULL) {
@@ -128,7 +432,13 @@ void *mm_malloc(size_t size)
         return bp;
     }
 
-    extendsize = MAX(asize, CHUNKSIZE);
+    /* Give back realloc headroom before growing the heap */
+    if (trim_grown() > 0 && (bp = find_fit(asize)) != NULL) {
+        place(bp, asize);
+        return bp;
+    }
+
+    extendsize = grow_by(asize);
 
     if  ((bp = extend_heap(extendsize/WSIZE)) == NULL)
         return NULL;
@@ -136,176 +446,1643 @@ void *mm_malloc(size_t size)
 
     place(bp, asize);
     return bp;
+}
 
+/*
+ * mm_malloc_hint - mm_malloc for an object whose lifetime the caller
+ *     can predict. A block for one expected to live long is cut from
+ *     the high end of a free block instead of the low end, so that
+ *     long-lived blocks collect at the tops of free regions and leave
+ *     the rest of them in one piece when short-lived neighbors go.
+ */
+void *mm_malloc_hint(size_t size, int hint)
+{
+    size_t asize, extendsize;
+    void *bp;
 
+    if (hint != MM_HINT_LONG || size <= SLAB_MAX)
+        return mm_malloc(size);
+    asize = adjust_size(size);
+    if (IS_LARGE(asize))
+        return mm_malloc(size);
+    TICK(1);
+    if ((bp = find_fit(asize)) == NULL &&
+        (trim_grown() == 0 || (bp = find_fit(asize)) == NULL)) {
+        extendsize = grow_by(asize);
+        if ((bp = extend_heap(extendsize / WSIZE)) == NULL)
+            return NULL;
+    }
+    bp = place_high(bp, asize);
+    SAMPLE(bp, size);
+    return bp;
 }
 
+/*
+ * adjust_size - The block size for a request of size bytes: overhead
+ *     and alignment added, and small blocks rounded up to their class.
+ */
+static size_t adjust_size(size_t size) {
+    size_t asize;
+
+    if (size <= DSIZE)
+        asize = 2 * DSIZE; // 최소 16바이트 (헤더 + 풋터 포함)
+    else
+        asize = ALIGN(size + SIZE_T_SIZE);
+    if (asize <= MM_CLASS_MAXBLOCK)
+        asize = mm_class_size[mm_class_index[asize / DSIZE]];
+    return asize;
+}
+
+/*
+ * mm_malloc_batch - Allocate n blocks of size bytes into out[0..n-1].
+ *     Each free block found is cut into as many blocks as it holds, so
+ *     the list search, the split and the list updates happen once per
+ *     free block instead of once per allocation. Returns the number of
+ *     blocks allocated, which is less than n only if the heap is full.
+ */
+size_t mm_malloc_batch(size_t size, size_t n, void **out)
+{
+    size_t asize, done = 0, extendsize, k, want;
+    void *bp;
+
+    if (size == 0 || n == 0)
+        return 0;
+    asize = adjust_size(size);
+    if (size <= SLAB_MAX || IS_LARGE(asize)) {
+        for (; done < n; done++)
+            if ((out[done] = mm_malloc(size)) == NULL)
+                break;
+        return done;
+    }
+
+    TICK(n);
+    while (done < n) {
+        /* Prefer one block for everything that is left, as much of it
+           as a 32-bit block size holds */
+        want = MIN(n - done, (~0U / 2) / asize) * asize;
+        if ((bp = find_fit(want)) == NULL &&
+            (bp = find_fit(asize)) == NULL &&
+            (trim_grown() == 0 || (bp = find_fit(asize)) == NULL)) {
+            /* One growth, whichever size it ends up taking */
+            extendsize = grow_by(want);
+            if ((bp = extend_heap(extendsize / WSIZE)) == NULL &&
+                (bp = extend_heap(shortfall(asize) / WSIZE)) == NULL)
+                break;
+        }
+        k = carve(bp, asize, n - done, out + done);
+        for (; k > 0; k--, done++)
+            SAMPLE(out[done], size);
+    }
+    return done;
+}
+
+/*
+ * carve - Cut up to n blocks of asize bytes from the front of free
+ *     block bp into out, and put the rest back on the free lists. A
+ *     remainder too small for a block goes to the last one. Returns
+ *     the number of blocks cut.
+ */
+static size_t carve(void *bp, size_t asize, size_t n, void **out) {
+    size_t csize = GET_SIZE(HDRP(bp));
+    size_t k = csize / asize, i, rest;
+    char *p = bp;
+
+    if (k > n)
+        k = n;
+    rest = csize - k * asize;
+    remove_free(bp);
+    for (i = 0; i < k; i++) {
+        size_t bsize = (i == k - 1 && rest < 2 * DSIZE) ? asize + rest : asize;
+
+        PUT(HDRP(p), PACK(bsize, 1));
+        PUT(FTRP(p), PACK(bsize, 1));
+        MARK(p, 1);
+        out[i] = p;
+        p = NEXT_BLKP(p);
+    }
+    if (FTRP(out[k - 1]) > fresh_lo)
+        fresh_lo = FTRP(out[k - 1]);
+    if (rest >= 2 * DSIZE) {
+        PUT(HDRP(p), PACK(rest, 0));
+        PUT(FTRP(p), PACK(rest, 0));
+        MARK(p, 0);
+        insert_free(p);
+        tally.splits++;
+    }
+    SETTLE();
+    return k;
+}
+
+/*
+ * mm_free_batch - Free n blocks. ptrs is sorted by address in place;
+ *     every run of adjacent blocks then becomes a single free block,
+ *     coalesced with its neighbors once. NULL entries are skipped, and
+ *     slab objects and large spans are freed, and cleared, first.
+ */
+void mm_free_batch(void **ptrs, size_t n)
+{
+    size_t i, size;
+    char *bp, *last;
+    span_t *s;
+
+    TICK(n);
+    for (i = 0; i < n; i++) {
+        if (ptrs[i] == NULL)
+            continue;
+        UNSAMPLE(ptrs[i]);
+        if ((s = pagemap_get(ptrs[i]))->kind != SPAN_BLOCKS) {
+            span_free(s, ptrs[i]);
+            ptrs[i] = NULL;
+        }
+    }
+    qsort(ptrs, n, sizeof(void *), cmp_addr);
+    for (i = 0; i < n; ) {
+        if ((bp = ptrs[i++]) == NULL)
+            continue;
+        if (GET_GROWN(HDRP(bp)))
+            forget_grown(bp);
+        size = GET_SIZE(HDRP(bp));
+        last = bp;
+        while (i < n && (char *)ptrs[i] == NEXT_BLKP(last)) {
+            last = ptrs[i++];
+            if (GET_GROWN(HDRP(last)))
+                forget_grown(last);
+            size += GET_SIZE(HDRP(last));
+            UNMARK(last);
+            tally.coalesces++;
+        }
+        PUT(HDRP(bp), PACK(size, 0));
+        PUT(FTRP(bp), PACK(size, 0));
+        coalesce(bp);
+    }
+}
+
+/* cmp_addr - qsort comparison of two block pointers by address */
+static int cmp_addr(const void *a, const void *b) {
+    char *p = *(char * const *)a, *q = *(char * const *)b;
+
+    return (p > q) - (p < q);
+}
+
+/*
+ * mm_realloc - Grow a block in place when its neighbor or the end of
+ *     the heap allows, and copy otherwise. A block that keeps growing
+ *     is marked GROWN and from then on gets 50% headroom, so a run of
+ *     small growth steps costs amortized linear copying. The headroom
+ *     is returned when the block is freed, or by trim_grown when the
+ *     heap would otherwise have to grow.
+ */
 void *mm_realloc(void *ptr, size_t size)
 {
     if (size == 0) { mm_free(ptr); return NULL; }
     if (ptr == NULL) return mm_malloc(size);
 
+    span_t *s = pagemap_get(ptr);
+    if (s->kind == SPAN_LARGE)
+        return realloc_large(s, size);
+    if (s->kind == SPAN_SLAB) {
+        size_t osize = SLAB_OBJ(s->sclass);
+        void *newptr;
+
+        if (size <= osize)
+            return ptr;
+        if ((newptr = mm_malloc(size)) == NULL)
+            return NULL;
+        memcopy(newptr, ptr, osize);
+        UNSAMPLE(ptr);
+        slab_free(s, ptr);
+        return newptr;
+    }
+
     size_t oldsize = GET_SIZE(HDRP(ptr));
-    size_t newsize;
+    size_t newsize, want;
 
     if (size <= DSIZE)
         newsize = 2 * DSIZE; // 최소 16바이트 (헤더 + 풋터 포함)
     else
         newsize = ALIGN(size + SIZE_T_SIZE);
 
-    if (newsize <= oldsize)  // 기존 블록이 충분히 큼
+    /* A large request always moves to a span, even if the block fits */
+    if (IS_LARGE(newsize)) {
+        void *newptr = malloc_large(size);
+        size_t copySize = oldsize - DSIZE;
+
+        if (newptr == NULL)
+            return NULL;
+        SAMPLE(newptr, size);
+        if (size < copySize) copySize = size;
+        memcopy(newptr, ptr, copySize);
+        mm_free(ptr);
+        return newptr;
+    }
+
+    if (newsize <= oldsize) {  // 기존 블록이 충분히 큼
+        if (GET_GROWN(HDRP(ptr)))
+            note_grown(ptr, newsize);
         return ptr;
+    }
+
+    /* A block grown before will likely grow again */
+    want = GET_GROWN(HDRP(ptr)) ? ALIGN(newsize + newsize / 2) : newsize;
+    if (IS_LARGE(want))
+        want = LARGE_MIN - DSIZE;              /* headroom stays a block */
+
+    if (grow_in_place(ptr, newsize, want)) {
+        note_grown(ptr, newsize);
+        return ptr;
+    }
 
     // 새 블록 할당
-    void *newptr = mm_malloc(size);
+    void *newptr = malloc_block(adjust_size(want - SIZE_T_SIZE));
     if (newptr == NULL)
         return NULL;
+    SAMPLE(newptr, size);
 
-    // 데이터 복사 (payload만큼)
-    size_t copySize = oldsize - DSIZE;
+    // 데이터 복사 (payload만큼). trim_grown may have shrunk ptr meanwhile.
+    size_t copySize = GET_SIZE(HDRP(ptr)) - DSIZE;
     if (size < copySize) copySize = size;
-    memcpy(newptr, ptr, copySize);
+    memcopy(newptr, ptr, copySize);
     mm_free(ptr);
+
+    PUT(HDRP(newptr), GET(HDRP(newptr)) | GROWN);
+    PUT(FTRP(newptr), GET(HDRP(newptr)));
+    note_grown(newptr, newsize);
     return newptr;
 }
 
+/*
+ * mm_calloc - Allocate zeroed memory for nmemb elements of size bytes.
+ *     A block from the fresh part of the heap is zero except for the
+ *     links and decay words at its start; anything else is cleared in
+ *     full.
+ */
+void *mm_calloc(size_t nmemb, size_t size)
+{
+    char *lo = fresh_lo;
+    size_t bytes;
+    void *bp;
+
+    if (nmemb != 0 && size > (size_t)-1 / nmemb)
+        return NULL;
+    bytes = nmemb * size;
+    if ((bp = mm_malloc(bytes)) == NULL)
+        return NULL;
+
+    if ((char *)bp >= lo)
+        memset(bp, 0, bytes < 2 * DSIZE ? bytes : 2 * DSIZE);
+    else
+        clear_block(bp, bytes);
+    return bp;
+}
+
+/*
+ * mm_memalign - Allocate size bytes whose address is a multiple of
+ *     align, a power of two. The free block found is split into a
+ *     free gap, the aligned block and a free tail.
+ */
+void *mm_memalign(size_t align, size_t size)
+{
+    size_t asize, extendsize;
+    char *bp, *p = NULL;
+    int i;
+
+    if (align == 0 || (align & (align - 1)) != 0)
+        return NULL;
+    if (align <= ALIGNMENT)
+        return mm_malloc(size);
+    /* Block sizes are 32 bits, and size + align must not wrap */
+    if (size == 0 || size > ~0U / 2 || align > ~0U / 2)
+        return NULL;
+
+    if (size <= DSIZE)
+        asize = 2 * DSIZE;
+    else
+        asize = ALIGN(size + SIZE_T_SIZE);
+    if (IS_LARGE(asize)) {
+        p = memalign_large(align, size);
+        SAMPLE(p, size);
+        return p;
+    }
+
+    /* First fit, where a block fits if an aligned payload does */
+    for (i = list_index(asize); i < NLISTS && p == NULL; i++)
+        for (bp = TO_BLKP(free_lists[i]); bp != NULL; bp = TO_BLKP(SUCC(bp)))
+            if ((p = aligned_in(bp, asize, align)) != NULL)
+                break;
+
+    /* Otherwise grow the heap by enough to fit at any alignment */
+    if (p == NULL) {
+        extendsize = grow_by(asize + align + 2 * DSIZE);
+        if ((bp = extend_heap(extendsize / WSIZE)) == NULL)
+            return NULL;
+        p = aligned_in(bp, asize, align);
+    }
+
+    /* Give the gap in front of p back as a free block of its own */
+    if (p != bp) {
+        size_t csize = GET_SIZE(HDRP(bp));
+
+        remove_free(bp);
+        PUT(HDRP(bp), PACK(p - bp, 0));
+        PUT(FTRP(bp), PACK(p - bp, 0));
+        TOUCH(bp, 1);
+        insert_free(bp);
+        PUT(HDRP(p), PACK(csize - (p - bp), 0));
+        PUT(FTRP(p), PACK(csize - (p - bp), 0));
+        MARK(p, 0);
+        insert_free(p);
+        tally.splits++;
+    }
+    place(p, asize);
+    SAMPLE(p, size);
+    return p;
+}
+
+/*
+ * mm_posix_memalign - posix_memalign(3) on top of mm_memalign.
+ */
+int mm_posix_memalign(void **memptr, size_t align, size_t size)
+{
+    void *p;
+
+    if (align == 0 || align % sizeof(void *) != 0 ||
+        (align & (align - 1)) != 0)
+        return EINVAL;
+    if (size == 0) {
+        *memptr = NULL;
+        return 0;
+    }
+    if ((p = mm_memalign(align, size)) == NULL)
+        return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+/*
+ * aligned_in - The first payload address in free block bp that is a
+ *     multiple of align and starts a block of asize bytes inside bp,
+ *     leaving either no gap or a gap big enough to be a free block.
+ *     NULL if there is none.
+ */
+static char *aligned_in(void *bp, size_t asize, size_t align) {
+    char *p = (char *)(((size_t)bp + align - 1) & ~(align - 1));
+
+    if (p != bp && p - (char *)bp < 2 * DSIZE)
+        p += align;
+    if (p + asize > (char *)bp + GET_SIZE(HDRP(bp)))
+        return NULL;
+    return p;
+}
+
+/*
+ * clear_block - Zero n bytes at p. Big blocks use non-temporal stores
+ *     so that clearing them does not flush the cache.
+ */
+static void clear_block(void *p, size_t n) {
+#ifdef __SSE2__
+    char *cp = p, *end = cp + n;
+    __m128i zero = _mm_setzero_si128();
+
+    if (n >= STREAM_CLEAR) {
+        /* Payloads are 8-byte aligned; the stores need 16 */
+        if ((size_t)cp & 15) {
+            memset(cp, 0, 8);
+            cp += 8;
+        }
+        for (; cp + 64 <= end; cp += 64) {
+            _mm_stream_si128((__m128i *)cp, zero);
+            _mm_stream_si128((__m128i *)(cp + 16), zero);
+            _mm_stream_si128((__m128i *)(cp + 32), zero);
+            _mm_stream_si128((__m128i *)(cp + 48), zero);
+        }
+        _mm_sfence();
+        memset(cp, 0, end - cp);
+        return;
+    }
+#endif
+    memset(p, 0, n);
+}
+
+/*
+ * scrub - Zero n bytes of allocator metadata at p, if they lie in the
+ *     fresh part of the heap that mm_calloc assumes is zero.
+ */
+static void scrub(void *p, size_t n) {
+    if ((char *)p >= fresh_lo)
+        memset(p, 0, n);
+}
+
+/*
+ * grow_in_place - Make allocated block bp at least need bytes, and up
+ *     to want bytes, without moving it: absorb a free successor and,
+ *     if the block ends the last segment of the heap, extend the heap by
+ *     the shortfall. Returns 0 if the block cannot grow in place.
+ */
+static int grow_in_place(void *bp, size_t need, size_t want) {
+    char *next = NEXT_BLKP(bp);
+    size_t avail = GET_SIZE(HDRP(bp));
+    size_t grow, rest;
+    int at_end;
+
+    if (!GET_ALLOC(HDRP(next))) {
+        avail += GET_SIZE(HDRP(next));
+        at_end = (NEXT_BLKP(next) == HEAP_BRK());
+    } else {
+        at_end = (next == HEAP_BRK());
+    }
+    if (avail < need && !at_end)
+        return 0;
+
+    if (avail < need) {
+        grow = want - avail;
+        if (mem_sbrk(grow) == (void *)-1) {
+            grow = need - avail;
+            if (mem_sbrk(grow) == (void *)-1)
+                return 0;
+        }
+        tally.seg_bytes += grow;
+        tally.extends++;
+        if (cover_brk(pagemap_get(bp)) < 0)
+            return 0;
+        avail += grow;
+    }
+    if (!GET_ALLOC(HDRP(next))) {
+        remove_free(next);
+        UNMARK(next);
+        if (at_end)
+            UNMARK(NEXT_BLKP(next));
+    } else if (at_end) {
+        UNMARK(next);
+    }
+
+    rest = (avail > want) ? avail - want : 0;
+    if (rest < 2 * DSIZE)
+        rest = 0;
+    PUT(HDRP(bp), PACK(avail - rest, 1 | GROWN));
+    PUT(FTRP(bp), PACK(avail - rest, 1 | GROWN));
+    if (FTRP(bp) > fresh_lo)
+        fresh_lo = FTRP(bp);
+    TOUCH(bp, 1);
+    next = NEXT_BLKP(bp);
+    if (rest > 0) {
+        /* The block after the remainder is allocated or the epilogue */
+        PUT(HDRP(next), PACK(rest, 0));
+        PUT(FTRP(next), PACK(rest, 0));
+        MARK(next, 0);
+        insert_free(next);
+        tally.splits++;
+        next = NEXT_BLKP(next);
+    }
+    if (at_end) {
+        PUT(HDRP(next), PACK(0, 1));
+        MARK(next, 1);
+    }
+    SETTLE();
+    return 1;
+}
+
+/*
+ * note_grown - Record that grown block bp needs need bytes, so that
+ *     trim_grown never cuts into live data. The oldest entry makes
+ *     room when the table is full; its block just keeps its headroom.
+ */
+static void note_grown(void *bp, size_t need) {
+    unsigned int off = TO_OFF(bp);
+    int i;
+
+    for (i = 0; i < NGROWN; i++)
+        if (grown[i].off == off) {
+            grown[i].need = need;
+            return;
+        }
+    grown[grown_next].off = off;
+    grown[grown_next].need = need;
+    grown_next = (grown_next + 1) % NGROWN;
+}
+
+/*
+ * forget_grown - Drop block bp from the grown table.
+ */
+static void forget_grown(void *bp) {
+    unsigned int off = TO_OFF(bp);
+    int i;
+
+    for (i = 0; i < NGROWN; i++)
+        if (grown[i].off == off)
+            grown[i].off = 0;
+}
 
+/*
+ * trim_grown - Cut the headroom off every grown block in the table and
+ *     free it. Returns the number of bytes released.
+ */
+static size_t trim_grown(void) {
+    size_t size, freed = 0;
+    char *bp, *tail;
+    int i;
+
+    for (i = 0; i < NGROWN; i++) {
+        if (grown[i].off == 0)
+            continue;
+        bp = TO_BLKP(grown[i].off);
+        size = GET_SIZE(HDRP(bp));
+        if (size < grown[i].need + 2 * DSIZE)
+            continue;
+        PUT(HDRP(bp), PACK(grown[i].need, 1 | GROWN));
+        PUT(FTRP(bp), PACK(grown[i].need, 1 | GROWN));
+        TOUCH(bp, 1);
+        tail = NEXT_BLKP(bp);
+        PUT(HDRP(tail), PACK(size - grown[i].need, 0));
+        PUT(FTRP(tail), PACK(size - grown[i].need, 0));
+        tally.splits++;
+        coalesce(tail);
+        freed += size - grown[i].need;
+    }
+    return freed;
+}
+
+/*
+ * extend_heap - Add a free block of at least words words to the heap:
+ *     at the end of the last segment if it ends the heap, else in a
+ *     new segment.
+ */
 static void *extend_heap(size_t words) {
+    span_t *s = pagemap_get(HEAP_BRK() - 1);
     char *bp;
     size_t size;
 
     /*Allocate an even number of words to maintain alignment*/
     size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
+    if (s->kind != SPAN_BLOCKS)
+        return new_segment(size);
     if ((bp = mem_sbrk(size)) == (void *)-1)
         return NULL;
-        
+    tally.seg_bytes += size;
+    tally.extends++;
+    if (cover_brk(s) < 0)
+        return NULL;
+
     /*Initialize free block header/footer and the epilogue header*/
     PUT(HDRP(bp), PACK(size, 0));
     PUT(FTRP(bp), PACK(size, 0));
     PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));
+    MARK(NEXT_BLKP(bp), 1);
 
     /* Coalesce with the next block if it is free*/
     return coalesce(bp);
 }
 
 /*
- * mm_free - Freeing a block does nothing.
+ * grow_by - shortfall, for a growth of the heap about to happen. A long
+ *     run of growths in quick succession doubles the chunk; an idle
+ *     spell resets it. Call it once per growth.
+ */
+static size_t grow_by(size_t asize) {
+    if (ticks - last_grow > GROW_IDLE) {
+        chunk = CHUNKSIZE;
+        streak = 0;
+    } else if (++streak % GROW_STREAK == 0 && chunk < GROW_MAX) {
+        chunk *= 2;
+    }
+    last_grow = ticks;
+    return shortfall(asize);
+}
+
+/*
+ * shortfall - How far to extend the heap for a free block of asize
+ *     bytes: to the growth chunk if that is bigger, less whatever free
+ *     block already ends the heap.
+ */
+static size_t shortfall(size_t asize) {
+    char *brk = HEAP_BRK();
+    size_t tail = 0, want;
+
+    if (pagemap_get(brk - 1)->kind == SPAN_BLOCKS && !GET_ALLOC(brk - DSIZE))
+        tail = GET_SIZE(brk - DSIZE);
+    want = MAX(asize, chunk);
+    if (tail + 2 * DSIZE >= want)
+        return 2 * DSIZE;
+    return want - tail;
+}
+
+/*
+ * new_segment - Start a segment holding a free block of at least size
+ *     bytes between its own prologue and epilogue.
+ */
+static void *new_segment(size_t size) {
+    span_t *s = alloc_pages(NPAGES(size + 2 * DSIZE));
+    char *bp;
+
+    if (s == NULL || use_span(s, SPAN_BLOCKS) < 0)
+        return NULL;
+    size = SPAN_BYTES(s) - 2 * DSIZE;
+    tally.seg_bytes += size;
+    PUT(s->start, 0);
+    PUT(s->start + (1 * WSIZE), PACK(DSIZE, 1));
+    PUT(s->start + (2 * WSIZE), PACK(DSIZE, 1));
+    bp = s->start + 2 * DSIZE;
+    PUT(HDRP(bp), PACK(size, 0));
+    PUT(FTRP(bp), PACK(size, 0));
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));
+    MARK(s->start + DSIZE, 1);
+    MARK(NEXT_BLKP(bp), 1);
+    return coalesce(bp);
+}
+
+/*
+ * cover_brk - Extend segment s, which ends the heap, to the pages up to
+ *     the current brk.
+ */
+static int cover_brk(span_t *s) {
+    size_t npages = NPAGES((size_t)(HEAP_BRK() - s->start));
+
+    if (pagemap_set(SPAN_END(s), npages - s->npages, s) < 0)
+        return -1;
+    s->npages = npages;
+    return 0;
+}
+
+/*
+ * alloc_pages - Take a run of npages pages from the page heap, growing
+ *     the heap if no free run is long enough. The span returned is not
+ *     yet mapped.
+ */
+static span_t *alloc_pages(size_t npages) {
+    span_t *s;
+
+    if ((s = pageheap_alloc(npages)) == NULL && pad_segment() == 0 &&
+        (s = pageheap_sbrk(npages)) != NULL)
+        tally.extends++;
+    return s;
+}
+
+/*
+ * pad_segment - If the heap ends in a segment, extend the segment to
+ *     the next page boundary, where new pages can start. Returns 0, or
+ *     -1 if the heap is full.
+ */
+static int pad_segment(void) {
+    char *brk = HEAP_BRK(), *bp;
+    size_t pad = (size_t)-(size_t)brk & (PM_PAGE - 1);
+    size_t size;
+
+    if (pad == 0)
+        return 0;
+    if (mem_sbrk(pad) == (void *)-1)
+        return -1;
+    tally.seg_bytes += pad;
+    if (pad >= 2 * DSIZE) {
+        /* A free block of its own where the epilogue was */
+        PUT(HDRP(brk), PACK(pad, 0));
+        PUT(FTRP(brk), PACK(pad, 0));
+        PUT(HDRP(NEXT_BLKP(brk)), PACK(0, 1));
+        MARK(NEXT_BLKP(brk), 1);
+        coalesce(brk);
+        return 0;
+    }
+
+    /* Too small for a block: the last block takes it */
+    bp = PREV_BLKP(brk);
+    size = GET_SIZE(HDRP(bp)) + pad;
+    if (GET_ALLOC(HDRP(bp))) {
+        PUT(HDRP(bp), PACK(size, GET(HDRP(bp)) & 0x7));
+        PUT(FTRP(bp), GET(HDRP(bp)));
+        if (FTRP(bp) > fresh_lo)
+            fresh_lo = FTRP(bp);
+    } else {
+        remove_free(bp);
+        scrub(brk - DSIZE, DSIZE);             /* footer, epilogue */
+        PUT(HDRP(bp), PACK(size, 0));
+        PUT(FTRP(bp), PACK(size, 0));
+        insert_free(bp);
+    }
+    TOUCH(bp, 1);
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));
+    UNMARK(brk);
+    MARK(NEXT_BLKP(bp), 1);
+    return 0;
+}
+
+/*
+ * use_span - Map every page of span s, just taken by alloc_pages, to s
+ *     and give it kind.
+ */
+static int use_span(span_t *s, int kind) {
+    s->kind = kind;
+    if (pagemap_set(s->start, s->npages, s) < 0) {
+        pageheap_free(s);
+        return -1;
+    }
+    if (kind != SPAN_BLOCKS && SPAN_END(s) > fresh_lo)
+        fresh_lo = SPAN_END(s);
+    return 0;
+}
+
+/*
+ * malloc_large - Allocate size bytes in a span of their own.
+ */
+static void *malloc_large(size_t size) {
+    span_t *s;
+
+    if (size > ~0U / 2)
+        return NULL;
+    if ((s = alloc_pages(NPAGES(size))) == NULL || use_span(s, SPAN_LARGE) < 0)
+        return NULL;
+    tally.large_bytes += SPAN_BYTES(s);
+    return s->start;
+}
+
+/*
+ * memalign_large - Allocate size bytes in a span of their own at a
+ *     multiple of align. Spans start on a page, so only an alignment
+ *     above the page size needs extra pages, which are freed again.
+ */
+static void *memalign_large(size_t align, size_t size) {
+    size_t npages = NPAGES(size);
+    size_t extra = align > PM_PAGE ? (align >> PM_PAGE_SHIFT) - 1 : 0;
+    span_t *s, *rest;
+    char *p;
+
+    if ((s = alloc_pages(npages + extra)) == NULL || use_span(s, SPAN_LARGE) < 0)
+        return NULL;
+    p = (char *)(((size_t)s->start + align - 1) & ~(align - 1));
+    if (p > s->start && (rest = span_new()) != NULL) {
+        rest->start = s->start;
+        rest->npages = (p - s->start) >> PM_PAGE_SHIFT;
+        s->start = p;
+        s->npages -= rest->npages;
+        pageheap_free(rest);
+    }
+    if (s->npages > npages && (rest = span_new()) != NULL) {
+        rest->start = s->start + (npages << PM_PAGE_SHIFT);
+        rest->npages = s->npages - npages;
+        s->npages = npages;
+        pageheap_free(rest);
+    }
+    if (s->start != p)
+        return NULL;
+    tally.large_bytes += SPAN_BYTES(s);
+    return p;
+}
+
+/*
+ * realloc_large - Resize large span s to size bytes. It grows in place
+ *     if the page heap has room right after it, and moves to a bigger
+ *     span, or to a slab or block if it is no longer large, otherwise.
+ */
+static void *realloc_large(span_t *s, size_t size) {
+    size_t npages = NPAGES(size), old;
+    char *newptr;
+
+    if (!IS_LARGE(ALIGN(size + SIZE_T_SIZE))) {
+        if ((newptr = mm_malloc(size)) == NULL)
+            return NULL;
+        memcopy(newptr, s->start, size);
+        UNSAMPLE(s->start);
+        tally.large_bytes -= SPAN_BYTES(s);
+        pageheap_free(s);
+        return newptr;
+    }
+    if (npages <= s->npages)
+        return s->start;
+    if (size > ~0U / 2)
+        return NULL;
+
+    old = SPAN_BYTES(s);
+    if (pageheap_grow(s, npages) < 0) {
+        if ((newptr = malloc_large(size)) == NULL)
+            return NULL;
+        memcopy(newptr, s->start, SPAN_BYTES(s));
+        SAMPLE(newptr, size);
+        UNSAMPLE(s->start);
+        tally.large_bytes -= SPAN_BYTES(s);
+        pageheap_free(s);
+        return newptr;
+    }
+    tally.large_bytes += SPAN_BYTES(s) - old;
+    if (SPAN_END(s) > fresh_lo)
+        fresh_lo = SPAN_END(s);
+    return s->start;
+}
+
+/*
+ * slab_alloc - Allocate an object of size bytes, at most SLAB_MAX, from
+ *     a slab of its class: a freed object if there is one, else the
+ *     next object never handed out.
+ */
+static void *slab_alloc(size_t size) {
+    int c = SLAB_CLASS(size);
+    span_t *s = slabs[c];
+    char *bp;
+
+    if (s == NULL && (s = new_slab(c)) == NULL)
+        return NULL;
+    if ((bp = s->objs) != NULL) {
+        s->objs = *(char **)bp;
+    } else {
+        bp = s->bump;
+        s->bump += SLAB_OBJ(c);
+    }
+    if (--s->nfree == 0) {
+        if ((slabs[c] = s->next) != NULL)
+            slabs[c]->prev = NULL;
+    }
+    tally.slab_bytes += SLAB_OBJ(c);
+    return bp;
+}
+
+/*
+ * new_slab - Make a slab for class c and put it on the class's list.
+ */
+static span_t *new_slab(int c) {
+    span_t *s;
+
+    if ((s = alloc_pages(SLAB_PAGES)) == NULL || use_span(s, SPAN_SLAB) < 0)
+        return NULL;
+    s->sclass = c;
+    s->nfree = SLAB_BYTES / SLAB_OBJ(c);
+    s->objs = NULL;
+    s->bump = s->start;
+    s->prev = NULL;
+    s->next = slabs[c];
+    if (slabs[c] != NULL)
+        slabs[c]->prev = s;
+    slabs[c] = s;
+    return s;
+}
+
+/*
+ * slab_free - Put object bp back in slab s. A slab that becomes empty
+ *     goes back to the page heap unless it is the only one of its class
+ *     with room, which keeps a class that keeps emptying from taking and
+ *     returning the same page.
+ */
+static void slab_free(span_t *s, void *bp) {
+    int c = s->sclass;
+
+    tally.slab_bytes -= SLAB_OBJ(c);
+    *(char **)bp = s->objs;
+    s->objs = bp;
+    if (s->nfree++ == 0) {
+        s->prev = NULL;
+        s->next = slabs[c];
+        if (slabs[c] != NULL)
+            slabs[c]->prev = s;
+        slabs[c] = s;
+    } else if (s->nfree == SLAB_BYTES / SLAB_OBJ(c) &&
+               (s->prev != NULL || s->next != NULL)) {
+        if (s->prev != NULL)
+            s->prev->next = s->next;
+        else
+            slabs[c] = s->next;
+        if (s->next != NULL)
+            s->next->prev = s->prev;
+        pageheap_free(s);
+    }
+}
+
+/*
+ * span_free - Free bp, the start of large span s or an object of slab s.
+ */
+static void span_free(span_t *s, void *bp) {
+    if (s->kind == SPAN_SLAB) {
+        slab_free(s, bp);
+    } else {
+        tally.large_bytes -= SPAN_BYTES(s);
+        pageheap_free(s);
+    }
+}
+
+/*
+ * mm_free - Free a block and coalesce it with its free neighbors, or
+ *     free a slab object or large span.
  */
 void mm_free(void *bp)
 {
-    size_t size = GET_SIZE(HDRP(bp));
+    span_t *s = pagemap_get(bp);
+    size_t size;
 
+    TICK(1);
+    UNSAMPLE(bp);
+    if (s->kind != SPAN_BLOCKS) {
+        span_free(s, bp);
+        return;
+    }
+    size = GET_SIZE(HDRP(bp));
+    if (GET_GROWN(HDRP(bp)))
+        forget_grown(bp);
     PUT(HDRP(bp), PACK(size, 0));
     PUT(FTRP(bp), PACK(size, 0));
     coalesce(bp);
 }
 
+/*
+ * mm_free_sized - Free block bp, which was allocated or last
+ *     reallocated with size bytes. The size tells what bp is: only
+ *     a block holds a size between the slab and large ranges, so that
+ *     is freed without the page map, and a slab-sized object goes to
+ *     its slab without the span kind dispatch. Blocks can be slab-sized
+ *     too (memalign'd, or shrunk by realloc), so those are checked.
+ */
+void mm_free_sized(void *bp, size_t size)
+{
+    span_t *s;
+    size_t asize;
+
+#ifdef MM_CHECK_SIZED
+    check_sized(bp, size);
+#endif
+    if (size <= SLAB_MAX) {
+        if ((s = pagemap_get(bp))->kind == SPAN_SLAB) {
+            TICK(1);
+            UNSAMPLE(bp);
+            slab_free(s, bp);
+            return;
+        }
+    } else if (!IS_LARGE(asize = adjust_size(size)) &&
+               GET(HDRP(bp)) == PACK(asize, 1)) {
+        /* One compare covers size, allocated bit and no GROWN bit */
+        TICK(1);
+        UNSAMPLE(bp);
+        PUT(HDRP(bp), PACK(asize, 0));
+        PUT((char *)bp + asize - DSIZE, PACK(asize, 0));
+        coalesce(bp);
+        return;
+    }
+    mm_free(bp);
+}
+
+#ifdef MM_CHECK_SIZED
+/*
+ * check_sized - Abort unless bp is an allocated block, slab object or
+ *     large span that can hold size bytes, and is large exactly when
+ *     size is. A block may be bigger than the size implies (a split
+ *     remainder, realloc headroom, a realloc that shrank in place), so
+ *     only the upper bound is checked.
+ */
+static void check_sized(void *bp, size_t size) {
+    span_t *s = pagemap_get(bp);
+    size_t bsize;
+    int bad;
+
+    if (s->kind == SPAN_LARGE) {
+        bsize = SPAN_BYTES(s) + DSIZE;
+        bad = (char *)bp != s->start || !IS_LARGE(adjust_size(size));
+    } else if (s->kind == SPAN_SLAB) {
+        bsize = SLAB_OBJ(s->sclass) + DSIZE;
+        bad = ((char *)bp - s->start) % SLAB_OBJ(s->sclass) != 0;
+    } else {
+        bsize = GET_SIZE(HDRP(bp));
+        bad = s->kind != SPAN_BLOCKS || !GET_ALLOC(HDRP(bp)) ||
+              IS_LARGE(adjust_size(size));
+    }
+    if (bad || size == 0 || size > bsize - DSIZE) {
+        fprintf(stderr, "mm_free_sized: block %p of %lu bytes freed with size %lu\n",
+                bp, (unsigned long)bsize, (unsigned long)size);
+        abort();
+    }
+}
+#endif
+
+/*
+ * coalesce - Merge free block bp with its free neighbors, which leave
+ *     their lists, and put the result on its list.
+ */
 static void *coalesce(void *bp)
 {
-    size_t prev_alloc = GET_ALLOC(HDRP(PREV_BLKP(bp)));
-    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
-    size_t size = GET_SIZE(HDRP(bp));
+    size_t size = GET_SIZE(HDRP(bp)), nsize;
+    size_t prev_alloc, next_alloc;
+    char *prev, *next = (char *)bp + size;
+    char *seam, *next_seam;                    /* tags that end up inside */
 
+    prev = PREV_BLKP(bp);
+#ifdef MM_BITMAP
+    /* The footer before bp shares its line; the next header is only
+       read if the block is merged */
+    prev_alloc = GET_ALLOC((char *)bp - DSIZE);
+    next_alloc = blockmap_is_alloc(next);
+#else
+    prev_alloc = GET_ALLOC(HDRP(prev));
+    next_alloc = GET_ALLOC(HDRP(next));
+#endif
 
     if (prev_alloc && next_alloc) {            /* Case 1 */
-        return bp;
     }
 
     else if (prev_alloc && !next_alloc) {      /* Case 2 */
-        size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
+        remove_free(next);
+        seam = FTRP(bp);
+        nsize = GET_SIZE(HDRP(next));
+        size += nsize;
         PUT(HDRP(bp), PACK(size, 0));
         PUT(FTRP(bp), PACK(size, 0));
+        /* footer, header, links and any decay words */
+        scrub(seam, nsize >= PURGE_MIN ? 3 * DSIZE : 2 * DSIZE);
+        UNMARK(next);
+        tally.coalesces++;
     }
 
     else if (!prev_alloc && next_alloc) {      /* Case 3 */
-        size += GET_SIZE(HDRP(PREV_BLKP(bp)));
+        remove_free(prev);
+        seam = (char *)bp - DSIZE;
+        size += GET_SIZE(HDRP(prev));
         PUT(FTRP(bp), PACK(size, 0));
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-        bp = PREV_BLKP(bp);
+        PUT(HDRP(prev), PACK(size, 0));
+        UNMARK(bp);
+        bp = prev;
+        scrub(seam, DSIZE);                    /* footer, header */
+        tally.coalesces++;
     }
 
     else {                                     /* Case 4 */
-        size += GET_SIZE(HDRP(PREV_BLKP(bp))) +
-                GET_SIZE(FTRP(NEXT_BLKP(bp)));
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-        bp = PREV_BLKP(bp);
+        remove_free(prev);
+        remove_free(next);
+        seam = (char *)bp - DSIZE;
+        next_seam = FTRP(bp);
+        nsize = GET_SIZE(HDRP(next));
+        size += GET_SIZE(HDRP(prev)) + nsize;
+        PUT(HDRP(prev), PACK(size, 0));
+        PUT(FTRP(next), PACK(size, 0));
+        UNMARK(bp);
+        UNMARK(next);
+        bp = prev;
+        scrub(seam, DSIZE);
+        scrub(next_seam, nsize >= PURGE_MIN ? 3 * DSIZE : 2 * DSIZE);
+        tally.coalesces += 2;
     }
-    last_bp = bp;
+    MARK(bp, 0);
+    insert_free(bp);
 
     return bp;
 }
 
-static void *first_fit(size_t asize) {
-    void *bp;
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
-        if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp))))
-            return bp;
+/*
+ * list_index - The list for a free block of the given size: the
+ *     largest class it can hold, or its power-of-two large list.
+ */
+static int list_index(size_t size) {
+    int i, c;
+
+    if (size <= MM_CLASS_MAXBLOCK) {
+        c = mm_class_index[size / DSIZE];
+        if (mm_class_size[c] > size && c > 0)
+            c--;
+        return c;
     }
-    return NULL;
+    i = 63 - __builtin_clzll(size / MM_CLASS_MAXBLOCK);
+    return MM_NCLASSES + (i < NLARGE - 1 ? i : NLARGE - 1);
 }
 
-static void *next_fit(size_t asize) {
-    void *bp;
+/*
+ * insert_free - Push free block bp on the front of its list.
+ */
+static void insert_free(void *bp) {
+    size_t size = GET_SIZE(HDRP(bp));
+    int i = list_index(size);
+    unsigned int off = TO_OFF(bp);
 
-    if (last_bp == NULL)
-        last_bp = heap_listp;
+    PRED(bp) = 0;
+    SUCC(bp) = free_lists[i];
+    if (free_lists[i])
+        PRED(TO_BLKP(free_lists[i])) = off;
+    free_lists[i] = off;
+    tally.lists[i].blocks++;
+    tally.lists[i].bytes += size;
+    if (size >= PURGE_MIN) {
+        size_t in = inside_pages(bp, NULL), p = MIN(purged_held, in);
 
-    for (bp = last_bp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
-        if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp))))
-        {
-            last_bp = bp;
-            return bp;
-        }
+        IDLE(bp) = (unsigned int)ticks;
+        PURGED(bp) = p;
+        purged_held -= p;
     }
+}
 
-    for (bp = heap_listp; bp < last_bp; bp = NEXT_BLKP(bp)) {
-        if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp))))
-        {
-            last_bp = bp;
-            return bp;
+/*
+ * remove_free - Unlink free block bp from its list.
+ */
+static void remove_free(void *bp) {
+    size_t size = GET_SIZE(HDRP(bp));
+    int i = list_index(size);
+
+    if (PRED(bp))
+        SUCC(TO_BLKP(PRED(bp))) = SUCC(bp);
+    else
+        free_lists[i] = SUCC(bp);
+    if (SUCC(bp))
+        PRED(TO_BLKP(SUCC(bp))) = PRED(bp);
+    tally.lists[i].blocks--;
+    tally.lists[i].bytes -= size;
+    if (size >= PURGE_MIN)
+        purged_held += PURGED(bp);
+}
+
+/*
+ * decay_pass - Purge the free runs that have outlived the decay
+ *     interval, and schedule the next pass
+ */
+static void decay_pass(void) {
+    next_pass = ticks + DECAY_PASS;
+    pageheap_purge(ticks, decay);
+    decay_blocks();
+}
+
+/*
+ * decay_blocks - Purge the pages inside every free block of PURGE_MIN
+ *     bytes or more that has been free for longer than the decay
+ *     interval. Only the lists of such blocks are walked.
+ */
+static void decay_blocks(void) {
+    size_t in;
+    char *bp, *lo;
+    int i;
+
+    if (decay >= ~0U)
+        return;
+    for (i = list_index(PURGE_MIN); i < NLISTS; i++)
+        for (bp = TO_BLKP(free_lists[i]); bp != NULL; bp = TO_BLKP(SUCC(bp))) {
+            if ((unsigned int)ticks - IDLE(bp) <= decay ||
+                (in = inside_pages(bp, &lo)) == PURGED(bp))
+                continue;
+            if (mem_purge(lo, in) < 0)
+                continue;
+            tally.purged += in - PURGED(bp);
+            PURGED(bp) = in;
         }
+}
+
+/*
+ * inside_pages - Bytes of the whole pages inside free block bp, clear
+ *     of its tags, links and decay words; the first is put in *lo
+ */
+static size_t inside_pages(void *bp, char **lo) {
+    char *p = (char *)(((size_t)bp + 2 * DSIZE + PM_PAGE - 1) & ~(size_t)(PM_PAGE - 1));
+    char *q = (char *)((size_t)FTRP(bp) & ~(size_t)(PM_PAGE - 1));
+
+    if (lo != NULL)
+        *lo = p;
+    return q > p ? (size_t)(q - p) : 0;
+}
+
+/*
+ * mm_set_decay - Purge free runs of pages, and the pages inside large
+ *     free blocks, once they have been idle for ops allocations and
+ *     frees; never if ops is negative.
+ */
+void mm_set_decay(long ops)
+{
+    decay = ops < 0 ? (unsigned long)-1 : (unsigned long)ops;
+}
+
+/*
+ * mm_decay_counts - Bytes purged since mm_init, and bytes of purged
+ *     pages handed out again
+ */
+void mm_decay_counts(size_t *purged, size_t *refaulted)
+{
+    pageheap_counts(purged, refaulted);
+    *purged += tally.purged;
+    *refaulted += tally.refaulted;
+}
+
+/*
+ * mm_stats - Add up the counters. Allocated block bytes are the bytes
+ *     of the segments less the free ones. The largest free block is on
+ *     the last list that has any, so only that list is searched.
+ */
+void mm_stats(mm_stats_t *st)
+{
+    size_t free_bytes = 0, run_bytes, size;
+    char *bp;
+    int i;
+
+    pageheap_stats(&run_bytes, &st->largest_free);
+    st->heap_size = mem_heapsize();
+    st->extends = tally.extends;
+    st->splits = tally.splits;
+    st->coalesces = tally.coalesces;
+    st->nlists = NLISTS;
+    for (i = 0; i < NLISTS; i++) {
+        if (i < MM_NCLASSES)
+            st->list_min[i] = mm_class_size[i];
+        else if (i == MM_NCLASSES)
+            st->list_min[i] = MM_CLASS_MAXBLOCK + DSIZE;
+        else
+            st->list_min[i] = (size_t)MM_CLASS_MAXBLOCK << (i - MM_NCLASSES);
+        st->free_blocks[i] = tally.lists[i].blocks;
+        free_bytes += tally.lists[i].bytes;
     }
+    st->alloc_bytes = tally.seg_bytes - free_bytes + tally.slab_bytes +
+                      tally.large_bytes;
+    st->free_bytes = free_bytes + run_bytes;
 
-    return NULL;
+    for (i = NLISTS - 1; i >= 0 && free_lists[i] == 0; i--)
+        ;
+    if (i >= 0)
+        for (bp = TO_BLKP(free_lists[i]); bp != NULL; bp = TO_BLKP(SUCC(bp)))
+            if ((size = GET_SIZE(HDRP(bp))) > st->largest_free)
+                st->largest_free = size;
+}
+
+/*
+ * mm_prof_start - Sample an allocation about every rate bytes into a
+ *     new heap profile; stop profiling if rate is 0.
+ */
+void mm_prof_start(size_t rate)
+{
+    heapprof_start(rate);
+}
+
+/*
+ * mm_prof_dump - Write the heap profile to f
+ */
+int mm_prof_dump(FILE *f)
+{
+    return heapprof_dump(f);
 }
 
-static void *best_fit(size_t asize) {
+/*
+ * mm_heap_walk - call visit on every block between the prologue and
+ *     the epilogue of every segment, and once for every slab, large
+ *     span and free run. Only for analysis; this is a full heap scan.
+ */
+void mm_heap_walk(mm_visit_funct visit, void *arg)
+{
+    char *p, *brk = HEAP_BRK();
     void *bp;
-    void *best_bp = NULL;
-    size_t best_size = 0;
-
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
-        if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp))))
-        {
-            if (best_bp == NULL || GET_SIZE(HDRP(bp)) < best_size)
-            {
-                best_bp = bp;
-                best_size = GET_SIZE(HDRP(bp));
+    span_t *s;
+
+    for (p = heap_listp; p < brk; p = SPAN_END(s)) {
+        s = pagemap_get(p);
+        if (s->kind != SPAN_BLOCKS) {
+            visit(s->start, SPAN_BYTES(s), s->kind != SPAN_FREE, arg);
+            continue;
+        }
+        for (bp = s->start + 2 * DSIZE; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+            visit(bp, GET_SIZE(HDRP(bp)), GET_ALLOC(HDRP(bp)), arg);
+    }
+}
+
+/*
+ * mm_check - Check the heap and report every problem found on stderr.
+ *     Returns the number of problems. MM_CHECK_INCR checks only the
+ *     blocks touched since the last call, and their neighbors, except
+ *     on the first call after mm_init or when the log overflowed.
+ */
+int mm_check(int mode)
+{
+    int bad;
+
+    if (mode == MM_CHECK_INCR && touch_on && !touch_lost)
+        bad = check_touched();
+    else
+        bad = check_full();
+    if (mode == MM_CHECK_INCR)
+        touch_on = 1;
+    ntouched = 0;
+    touch_lost = 0;
+    return bad;
+}
+
+/*
+ * touch - Log that the tags of the block at bp changed, and whether a
+ *     block still starts there. A full log is given up on; the next
+ *     check is a full one.
+ */
+static void touch(void *bp, int start) {
+    if (ntouched == TOUCH_MAX) {
+        touch_lost = 1;
+        return;
+    }
+    touched[ntouched] = (unsigned long long)TO_OFF(bp) << 32 |
+                        (unsigned long long)ntouched << 1 | start;
+    ntouched++;
+}
+
+/*
+ * check_touched - Check every logged address that a block starts at
+ *     now, with the blocks on both sides of it; only the one before an
+ *     epilogue, whose move means the last block changed. Sorting the
+ *     log brings the events at each address together, oldest first, so
+ *     the last one tells whether a block is still there.
+ */
+static int check_touched(void) {
+    char *bp, *next, *prev;
+    size_t psize;
+    span_t *s;
+    int bad = 0, i;
+
+    qsort(touched, ntouched, sizeof(touched[0]), cmp_touch);
+    for (i = 0; i < ntouched; i++) {
+        if (i + 1 < ntouched && touched[i + 1] >> 32 == touched[i] >> 32)
+            continue;
+        if (!(touched[i] & 1))
+            continue;
+        bp = heap_base + (touched[i] >> 32);
+        if ((s = segment_of(HDRP(bp))) == NULL) {
+            bad += complain(bp, "block outside every segment");
+            continue;
+        }
+        if (check_block(bp, s) != 0) {
+            bad++;
+            continue;
+        }
+        if (bp == s->start + DSIZE)
+            continue;                          /* prologue */
+        if (GET_SIZE(HDRP(bp)) != 0) {
+            next = NEXT_BLKP(bp);
+            bad += check_block(next, s);
+        }
+        psize = GET_SIZE(bp - DSIZE);
+        prev = bp - psize;
+        if (psize < DSIZE || prev < s->start + DSIZE)
+            bad += complain(bp, "footer before the block is corrupt");
+        else
+            bad += check_block(prev, s);
+    }
+    return bad;
+}
+
+/* cmp_touch - qsort comparison of two log entries */
+static int cmp_touch(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * check_full - Walk every span of the heap and every free list. Spans
+ *     must tile the heap and be found in the page map; segments are
+ *     checked block by block from prologue to epilogue, and slabs by
+ *     their free objects. Every list must hold exactly the free blocks
+ *     of its size class that the walk found, as many as tally counts.
+ */
+static int check_full(void) {
+    char *p, *bp, *brk = HEAP_BRK();
+    size_t nfree = 0, nslabs = 0, listed = 0, n, bytes, k, objs;
+    unsigned int off, pred;
+    span_t *s, *t;
+    int bad = 0, i;
+
+    for (p = mem_heap_lo(); p < brk; p = SPAN_END(s)) {
+        s = pagemap_get(p);
+        if (s == NULL || s->start != p || s->npages == 0)
+            return bad + complain(p, "no span starts here");
+        if (s->kind == SPAN_FREE) {
+            /* The page heap maps only the ends of a free run */
+            if (pagemap_get(SPAN_END(s) - 1) != s)
+                bad += complain(p, "free run not in the page map");
+            continue;
+        }
+        for (k = 0; k < s->npages; k++)
+            if (pagemap_get(p + (k << PM_PAGE_SHIFT)) != s) {
+                bad += complain(p, "span not in the page map");
+                break;
+            }
+
+        if (s->kind == SPAN_SLAB) {
+            nslabs++;
+            if (s->sclass < 0 || s->sclass >= NSLABS) {
+                bad += complain(p, "slab of no class");
+                continue;
+            }
+            objs = SLAB_BYTES / SLAB_OBJ(s->sclass);
+            if (s->bump < s->start || s->bump > s->start + objs * SLAB_OBJ(s->sclass) ||
+                (s->bump - s->start) % SLAB_OBJ(s->sclass) != 0) {
+                bad += complain(p, "slab bump pointer out of place");
+                continue;
             }
+            n = objs - (s->bump - s->start) / SLAB_OBJ(s->sclass);
+            for (bp = s->objs; bp != NULL && n <= s->nfree; bp = *(char **)bp, n++)
+                if (bp < s->start || bp >= s->bump ||
+                    (bp - s->start) % SLAB_OBJ(s->sclass) != 0)
+                    break;
+            if (bp != NULL && n <= s->nfree)
+                bad += complain(bp, "slab object out of place");
+            else if (bp != NULL || n != s->nfree)
+                bad += complain(p, "slab free count is off");
+            continue;
+        }
+        if (s->kind != SPAN_BLOCKS) {
+            if (s->kind != SPAN_LARGE)
+                bad += complain(p, "span of no kind");
+            continue;
+        }
+
+        bad += check_block(s->start + DSIZE, s);
+        for (bp = s->start + 2 * DSIZE; ; bp = NEXT_BLKP(bp)) {
+            if (check_block(bp, s) != 0) {
+                bad++;
+                break;
+            }
+            if (GET_SIZE(HDRP(bp)) == 0)
+                break;
+            if (!GET_ALLOC(HDRP(bp)))
+                nfree++;
         }
     }
 
-    return best_bp;
+    for (i = 0; i < NSLABS; i++)
+        for (t = slabs[i], n = 0; t != NULL; t = t->next)
+            if (++n > nslabs || t->kind != SPAN_SLAB || t->sclass != i ||
+                t->nfree == 0 || (t->next != NULL && t->next->prev != t)) {
+                fprintf(stderr, "mm_check: slab list %d is corrupt\n", i);
+                bad++;
+                break;
+            }
+
+    for (i = 0; i < NLISTS; i++) {
+        n = bytes = 0;
+        for (off = free_lists[i], pred = 0; off != 0 && n <= nfree;
+             pred = off, off = SUCC(bp), n++) {
+            if ((bp = link_blkp(off)) == NULL) {
+                bad += complain(heap_base + off, "not a free block, but listed");
+                break;
+            }
+            if (list_index(GET_SIZE(HDRP(bp))) != i)
+                bad += complain(bp, "on the list of another size");
+            if (PRED(bp) != pred)
+                bad += complain(bp, "predecessor link is off");
+            bytes += GET_SIZE(HDRP(bp));
+        }
+        if (off != 0) {
+            fprintf(stderr, "mm_check: free list %d does not end\n", i);
+            bad++;
+        } else if (n != tally.lists[i].blocks || bytes != tally.lists[i].bytes) {
+            fprintf(stderr, "mm_check: free list %d holds %lu blocks of %lu bytes, "
+                    "not %lu of %lu\n", i, (unsigned long)n, (unsigned long)bytes,
+                    (unsigned long)tally.lists[i].blocks,
+                    (unsigned long)tally.lists[i].bytes);
+            bad++;
+        }
+        listed += n;
+    }
+    if (listed != nfree) {
+        fprintf(stderr, "mm_check: %lu free blocks, but %lu on the lists\n",
+                (unsigned long)nfree, (unsigned long)listed);
+        bad++;
+    }
+    return bad;
+}
+
+/*
+ * check_block - Check the block at bp, whose header lies in segment s:
+ *     a prologue, an epilogue, or a block whose tags agree and that
+ *     stays inside s. A free block must sit between allocated ones and
+ *     be linked into the list of its size. Reports the first problem
+ *     and returns 1, or returns 0.
+ */
+static int check_block(char *bp, span_t *s) {
+    unsigned int hdr = GET(HDRP(bp));
+    size_t size = GET_SIZE(HDRP(bp));
+    char *next, *link;
+    int i;
+
+    if (((size_t)bp & (ALIGNMENT - 1)) != 0)
+        return complain(bp, "payload not aligned");
+    if (bp == s->start + DSIZE) {
+        if (hdr != PACK(DSIZE, 1) || GET(bp) != hdr)
+            return complain(bp, "prologue overwritten");
+        return 0;
+    }
+    if (size == 0) {
+        if (hdr != PACK(0, 1) || (bp != SPAN_END(s) && bp != HEAP_BRK()))
+            return complain(bp, "epilogue out of place");
+        return 0;
+    }
+    next = bp + size;
+    if (size < 2 * DSIZE || (hdr & 0x4) != 0 || bp < s->start + 2 * DSIZE ||
+        next > SPAN_END(s) || next > HEAP_BRK())
+        return complain(bp, "header is corrupt");
+    if (GET(FTRP(bp)) != hdr)
+        return complain(bp, "header and footer differ");
+#ifdef MM_BITMAP
+    if (!blockmap_is_start(bp) || blockmap_is_alloc(bp) != GET_ALLOC(HDRP(bp)) ||
+        blockmap_next(bp) != next)
+        return complain(bp, "bitmaps disagree with the tags");
+#endif
+    if (GET_ALLOC(HDRP(bp)))
+        return 0;
+
+    if (hdr & GROWN)
+        return complain(bp, "free block marked grown");
+    if (!GET_ALLOC(bp - DSIZE) || !GET_ALLOC(HDRP(next)))
+        return complain(bp, "free block next to a free block");
+    i = list_index(size);
+    if (PRED(bp) == 0) {
+        if (free_lists[i] != TO_OFF(bp))
+            return complain(bp, "free block not on its list");
+    } else if ((link = link_blkp(PRED(bp))) == NULL || SUCC(link) != TO_OFF(bp) ||
+               list_index(GET_SIZE(HDRP(link))) != i) {
+        return complain(bp, "predecessor link is off");
+    }
+    if (SUCC(bp) != 0 &&
+        ((link = link_blkp(SUCC(bp))) == NULL || PRED(link) != TO_OFF(bp) ||
+         list_index(GET_SIZE(HDRP(link))) != i))
+        return complain(bp, "successor link is off");
+    return 0;
+}
+
+/*
+ * segment_of - The segment holding heap address p, or NULL if p lies
+ *     outside the heap or in a span of another kind
+ */
+static span_t *segment_of(char *p) {
+    span_t *s;
+
+    if (p < (char *)mem_heap_lo() || p >= HEAP_BRK())
+        return NULL;
+    s = pagemap_get(p);
+    if (s == NULL || s->kind != SPAN_BLOCKS || p < s->start || p >= SPAN_END(s))
+        return NULL;
+    return s;
+}
+
+/*
+ * link_blkp - The free block that a list link off leads to, or NULL if
+ *     there is no free block there
+ */
+static char *link_blkp(unsigned int off) {
+    char *bp = heap_base + off;
+    span_t *s;
+
+    if ((off & (ALIGNMENT - 1)) != 0 || (s = segment_of(HDRP(bp))) == NULL ||
+        bp < s->start + 2 * DSIZE || GET_ALLOC(HDRP(bp)))
+        return NULL;
+    return bp;
+}
+
+/* complain - Report a problem with the heap at p; counts as one */
+static int complain(void *p, const char *what) {
+    fprintf(stderr, "mm_check: %p: %s\n", p, what);
+    return 1;
 }
 
+/*
+ * find_fit - First fit, starting at the list of asize. Every block on
+ *     the list of a class holds that class, so for small requests the
+ *     first block looked at fits.
+ */
 static void *find_fit(size_t asize) {
-    return next_fit(asize);
+    char *bp;
+    int i;
+
+    for (i = list_index(asize); i < NLISTS; i++)
+        for (bp = TO_BLKP(free_lists[i]); bp != NULL; bp = TO_BLKP(SUCC(bp)))
+            if (GET_SIZE(HDRP(bp)) >= asize)
+                return bp;
+    return NULL;
 }
 
 static void place(void *bp, size_t asize) {
     size_t csize = GET_SIZE(HDRP(bp));
 
+    remove_free(bp);
     if ((csize - asize) >= (2 * DSIZE)) {
         PUT(HDRP(bp), PACK(asize, 1));
         PUT(FTRP(bp), PACK(asize, 1));
+        if (FTRP(bp) > fresh_lo)
+            fresh_lo = FTRP(bp);
+        MARK(bp, 1);
         bp = NEXT_BLKP(bp);
         PUT(HDRP(bp), PACK(csize - asize, 0));
         PUT(FTRP(bp), PACK(csize - asize, 0));
-        last_bp = bp;
+        MARK(bp, 0);
+        insert_free(bp);
+        tally.splits++;
     } else {
         PUT(HDRP(bp), PACK(csize, 1));
         PUT(FTRP(bp), PACK(csize, 1));
-        last_bp = NEXT_BLKP(bp);
+        if (FTRP(bp) > fresh_lo)
+            fresh_lo = FTRP(bp);
+        MARK(bp, 1);
     }
-}
\ No newline at end of file
+    SETTLE();
+}
+
+/*
+ * place_high - place, but with the remainder left at the front of bp and
+ *     the allocated block cut from its end. Returns the allocated block.
+ */
+static void *place_high(void *bp, size_t asize) {
+    size_t csize = GET_SIZE(HDRP(bp));
+
+    if ((csize - asize) < (2 * DSIZE)) {
+        place(bp, asize);
+        return bp;
+    }
+    remove_free(bp);
+    PUT(HDRP(bp), PACK(csize - asize, 0));
+    PUT(FTRP(bp), PACK(csize - asize, 0));
+    MARK(bp, 0);
+    insert_free(bp);
+    tally.splits++;
+    bp = NEXT_BLKP(bp);
+    PUT(HDRP(bp), PACK(asize, 1));
+    PUT(FTRP(bp), PACK(asize, 1));
+    if (FTRP(bp) > fresh_lo)
+        fresh_lo = FTRP(bp);
+    MARK(bp, 1);
+    SETTLE();
+    return bp;
+}
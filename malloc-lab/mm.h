@@ -3,7 +3,102 @@
 extern int mm_init (void);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
+extern void mm_free_sized(void *ptr, size_t size);
 extern void *mm_realloc(void *ptr, size_t size);
+extern void *mm_calloc(size_t nmemb, size_t size);
+extern void *mm_memalign(size_t align, size_t size);
+extern int mm_posix_memalign(void **memptr, size_t align, size_t size);
+extern size_t mm_malloc_batch(size_t size, size_t n, void **out);
+extern void mm_free_batch(void **ptrs, size_t n);
+
+/*
+ * mm_malloc with a prediction of the object's lifetime. Objects hinted
+ * MM_HINT_LONG are kept apart from the rest, so that they do not pin
+ * the memory around objects that come and go.
+ */
+#define MM_HINT_NONE 0
+#define MM_HINT_LONG 1
+extern void *mm_malloc_hint(size_t size, int hint);
+
+/*
+ * Free runs of pages, and the whole pages inside free blocks of two
+ * pages or more, that stay idle for more than ops allocations and
+ * frees are given back to the OS (never if ops < 0). mm_decay_counts
+ * reports the bytes purged since mm_init and the bytes of purged pages
+ * handed out again.
+ */
+extern void mm_set_decay(long ops);
+extern void mm_decay_counts(size_t *purged, size_t *refaulted);
+
+/*
+ * Allocator statistics. The counters are kept up to date as the heap
+ * changes, so mm_stats only adds them up, in time proportional to the
+ * number of free lists. alloc_bytes counts allocated blocks, slab
+ * objects and large spans in full; free_bytes counts free blocks and
+ * free runs of pages. What the heap holds beyond the two is overhead:
+ * segment prologues and epilogues and the unused room in slabs.
+ */
+#define MM_STATS_LISTS 32
+typedef struct {
+    size_t heap_size;            /* bytes the heap has grown to */
+    size_t alloc_bytes;
+    size_t free_bytes;
+    size_t largest_free;         /* largest free block or free run */
+    size_t extends;              /* times the heap grew */
+    size_t splits;               /* free blocks cut off larger blocks */
+    size_t coalesces;            /* merges of free neighbors */
+    int nlists;                  /* free lists, at most MM_STATS_LISTS */
+    size_t list_min[MM_STATS_LISTS];    /* smallest block on each list */
+    size_t free_blocks[MM_STATS_LISTS]; /* blocks on each list */
+} mm_stats_t;
+extern void mm_stats(mm_stats_t *st);
+
+/*
+ * Sampling heap profiler (heapprof.h). mm_prof_start starts a new
+ * profile that records the call stack of about one allocation in every
+ * rate bytes, or stops profiling if rate is 0. mm_prof_dump writes the
+ * profile in the heap profile format of pprof; it returns 0, or -1 on
+ * a write error.
+ */
+extern void mm_prof_start(size_t rate);
+extern int mm_prof_dump(FILE *f);
+
+/*
+ * Regions (region.c) hand out memory that is freed all at once:
+ * mm_region_reset frees every object allocated from the region, which
+ * stays usable, and mm_region_destroy frees the region as well.
+ * Objects from a region must not be passed to mm_free or mm_realloc.
+ */
+typedef struct mm_region mm_region_t;
+extern mm_region_t *mm_region_create(void);
+extern void *mm_region_alloc(mm_region_t *r, size_t size);
+extern void mm_region_reset(mm_region_t *r);
+extern void mm_region_destroy(mm_region_t *r);
+
+/*
+ * Heap introspection for analysis tools. mm_heap_walk calls visit once
+ * for every block in address order with its payload pointer, total
+ * block size (including overhead) and allocation status. A slab of
+ * small objects, a large allocation or a free run of pages counts as
+ * one block.
+ */
+typedef void (*mm_visit_funct)(void *bp, size_t size, int alloc, void *arg);
+extern void mm_heap_walk(mm_visit_funct visit, void *arg);
+
+/*
+ * Heap consistency checker. mm_check reports every problem it finds on
+ * stderr and returns their number. MM_CHECK_FULL walks the whole heap:
+ * boundary tags agree, no two free blocks are neighbors, every free
+ * block is on the list of its size class and no other block is,
+ * prologues and epilogues are intact, and spans tile the heap.
+ * MM_CHECK_INCR checks only the blocks whose tags changed since the
+ * last call, with their neighbors, so it is cheap enough to call after
+ * every operation; the allocator logs those blocks from the first
+ * MM_CHECK_INCR call after mm_init, which checks in full.
+ */
+#define MM_CHECK_FULL 0
+#define MM_CHECK_INCR 1
+extern int mm_check(int mode);
 
 
 /* 
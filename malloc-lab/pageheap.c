@@ -0,0 +1,305 @@
+/*
+ * pageheap.c - free runs of pages on per-length lists
+ */
+#include "memlib.h"
+#include "pageheap.h"
+
+#define NWORDS ((PH_MAXPAGES + 64) / 64)
+
+#define SPAN_END(s) ((s)->start + ((s)->npages << PM_PAGE_SHIFT))
+#define HEAP_BRK() ((char *)mem_heap_hi() + 1)
+
+/* runs[n] holds the free runs of n pages, runs[PH_MAXPAGES] the rest */
+static span_t *runs[PH_MAXPAGES + 1];
+static unsigned long long nonempty[NWORDS];   /* bit n: runs[n] != NULL */
+
+static size_t free_pages;                /* in all the runs on the lists */
+
+static unsigned long clock_now;          /* time of the last purge pass */
+static size_t purged, refaulted;         /* bytes, since pageheap_init */
+
+/* list_of - The list for a run of npages pages */
+static int list_of(size_t npages)
+{
+    return npages < PH_MAXPAGES ? (int)npages : PH_MAXPAGES;
+}
+
+/*
+ * insert_run/remove_run - Put free run s on its list, and take it off
+ */
+static void insert_run(span_t *s)
+{
+    int i = list_of(s->npages);
+
+    s->kind = SPAN_FREE;
+    s->prev = NULL;
+    s->next = runs[i];
+    if (runs[i] != NULL)
+        runs[i]->prev = s;
+    runs[i] = s;
+    nonempty[i / 64] |= 1ULL << (i % 64);
+    free_pages += s->npages;
+}
+
+static void remove_run(span_t *s)
+{
+    int i = list_of(s->npages);
+
+    if (s->prev != NULL)
+        s->prev->next = s->next;
+    else if ((runs[i] = s->next) == NULL)
+        nonempty[i / 64] &= ~(1ULL << (i % 64));
+    if (s->next != NULL)
+        s->next->prev = s->prev;
+    free_pages -= s->npages;
+}
+
+/*
+ * map_ends - Map the first and last page of free run s to it
+ */
+static void map_ends(span_t *s)
+{
+    pagemap_set(s->start, 1, s);
+    pagemap_set(SPAN_END(s) - PM_PAGE, 1, s);
+}
+
+/*
+ * take_purged - Count the purged pages among the first npages pages
+ *     taken from free run s as refaulted
+ */
+static void take_purged(span_t *s, size_t npages)
+{
+    if (npages > s->npurged)
+        npages = s->npurged;
+    s->npurged -= npages;
+    refaulted += npages << PM_PAGE_SHIFT;
+}
+
+/*
+ * first_list - The first non-empty list at or after list i, or -1
+ */
+static int first_list(int i)
+{
+    unsigned long long bits;
+    int w;
+
+    for (w = i / 64; w < NWORDS; w++) {
+        bits = nonempty[w];
+        if (w == i / 64)
+            bits &= ~0ULL << (i % 64);
+        if (bits != 0)
+            return w * 64 + __builtin_ctzll(bits);
+    }
+    return -1;
+}
+
+/*
+ * pageheap_init - Forget all free runs
+ */
+void pageheap_init(void)
+{
+    int i;
+
+    for (i = 0; i <= PH_MAXPAGES; i++)
+        runs[i] = NULL;
+    for (i = 0; i < NWORDS; i++)
+        nonempty[i] = 0;
+    free_pages = 0;
+    clock_now = 0;
+    purged = refaulted = 0;
+}
+
+/*
+ * pageheap_alloc - The shortest free run of at least npages pages, with
+ *     anything beyond npages split off and put back
+ */
+span_t *pageheap_alloc(size_t npages)
+{
+    span_t *s, *best = NULL, *rest;
+    int i;
+
+    if ((i = first_list(list_of(npages))) < 0)
+        return NULL;
+    if (i < PH_MAXPAGES) {
+        best = runs[i];
+    } else {
+        for (s = runs[PH_MAXPAGES]; s != NULL; s = s->next)
+            if (s->npages >= npages && (best == NULL || s->npages < best->npages))
+                best = s;
+        if (best == NULL)
+            return NULL;
+    }
+
+    remove_run(best);
+    if (best->npages > npages) {
+        if ((rest = span_new()) == NULL) {
+            insert_run(best);
+            return NULL;
+        }
+        /* best had no free neighbors, so neither has the rest */
+        take_purged(best, npages);
+        rest->start = best->start + (npages << PM_PAGE_SHIFT);
+        rest->npages = best->npages - npages;
+        rest->idle = best->idle;
+        rest->npurged = best->npurged;
+        best->npages = npages;
+        map_ends(rest);
+        insert_run(rest);
+    } else {
+        take_purged(best, npages);
+    }
+    best->npurged = 0;
+    return best;
+}
+
+/*
+ * pageheap_sbrk - New pages from the end of the heap
+ */
+span_t *pageheap_sbrk(size_t npages)
+{
+    char *brk = HEAP_BRK();
+    span_t *s = NULL;
+
+    if ((size_t)brk & (PM_PAGE - 1))
+        return NULL;
+    if (brk > (char *)mem_heap_lo() &&
+        (s = pagemap_get(brk - 1))->kind == SPAN_FREE && s->npages < npages) {
+        if (mem_sbrk((npages - s->npages) << PM_PAGE_SHIFT) == (void *)-1)
+            return NULL;
+        remove_run(s);
+        take_purged(s, s->npages);
+        s->npages = npages;
+        return s;
+    }
+
+    if ((s = span_new()) == NULL)
+        return NULL;
+    if (mem_sbrk(npages << PM_PAGE_SHIFT) == (void *)-1) {
+        span_delete(s);
+        return NULL;
+    }
+    s->start = brk;
+    s->npages = npages;
+    return s;
+}
+
+/*
+ * pageheap_grow - Grow s in place into the free run after it, extended
+ *     if it ends the heap, or into new pages if s itself ends the heap
+ */
+int pageheap_grow(span_t *s, size_t npages)
+{
+    size_t more = npages - s->npages;
+    span_t *n = NULL;
+
+    if (SPAN_END(s) < HEAP_BRK()) {
+        n = pagemap_get(SPAN_END(s));
+        if (n->kind != SPAN_FREE)
+            return -1;
+        if (n->npages < more &&
+            (SPAN_END(n) != HEAP_BRK() ||
+             mem_sbrk((more - n->npages) << PM_PAGE_SHIFT) == (void *)-1))
+            return -1;
+        remove_run(n);
+        take_purged(n, more);
+        if (n->npages > more) {
+            n->start += more << PM_PAGE_SHIFT;
+            n->npages -= more;
+            map_ends(n);
+            insert_run(n);
+        } else {
+            span_delete(n);
+        }
+    } else if (mem_sbrk(more << PM_PAGE_SHIFT) == (void *)-1) {
+        return -1;
+    }
+    if (pagemap_set(SPAN_END(s), more, s) < 0)
+        return -1;
+    s->npages = npages;
+    return 0;
+}
+
+/*
+ * pageheap_free - Merge s with the free runs on either side of it and
+ *     put the result on its list
+ */
+void pageheap_free(span_t *s)
+{
+    span_t *n;
+
+    if (s->start > (char *)mem_heap_lo() &&
+        (n = pagemap_get(s->start - 1))->kind == SPAN_FREE) {
+        remove_run(n);
+        s->start = n->start;
+        s->npages += n->npages;
+        s->npurged += n->npurged;
+        span_delete(n);
+    }
+    if (SPAN_END(s) < HEAP_BRK() &&
+        (n = pagemap_get(SPAN_END(s)))->kind == SPAN_FREE) {
+        remove_run(n);
+        s->npages += n->npages;
+        s->npurged += n->npurged;
+        span_delete(n);
+    }
+    s->idle = clock_now;
+    map_ends(s);
+    insert_run(s);
+}
+
+/*
+ * pageheap_purge - Give the pages of every free run that has been free
+ *     for longer than decay back to the OS
+ */
+size_t pageheap_purge(unsigned long now, unsigned long decay)
+{
+    size_t bytes = 0;
+    span_t *s;
+    int i, failed = 0;
+
+    clock_now = now;
+    for (i = first_list(1); i >= 0 && !failed; i = first_list(i + 1))
+        for (s = runs[i]; s != NULL; s = s->next) {
+            if (s->npurged == s->npages || now - s->idle <= decay)
+                continue;
+            /* Stop, but still count the runs purged so far */
+            if (mem_purge(s->start, s->npages << PM_PAGE_SHIFT) < 0) {
+                failed = 1;
+                break;
+            }
+            bytes += (s->npages - s->npurged) << PM_PAGE_SHIFT;
+            s->npurged = s->npages;
+        }
+    purged += bytes;
+    return bytes;
+}
+
+/*
+ * pageheap_stats - Bytes in free runs, and in the longest of them. Only
+ *     the list of the longest runs is searched.
+ */
+void pageheap_stats(size_t *free_bytes, size_t *largest)
+{
+    size_t most = 0;
+    span_t *s;
+    int w, i = -1;
+
+    for (w = NWORDS - 1; w >= 0 && i < 0; w--)
+        if (nonempty[w] != 0)
+            i = w * 64 + 63 - __builtin_clzll(nonempty[w]);
+    if (i >= 0)
+        for (s = runs[i]; s != NULL; s = s->next)
+            if (s->npages > most)
+                most = s->npages;
+    *free_bytes = free_pages << PM_PAGE_SHIFT;
+    *largest = most << PM_PAGE_SHIFT;
+}
+
+/*
+ * pageheap_counts - Bytes purged and refaulted since pageheap_init
+ */
+void pageheap_counts(size_t *purged_bytes, size_t *refaulted_bytes)
+{
+    *purged_bytes = purged;
+    *refaulted_bytes = refaulted;
+}
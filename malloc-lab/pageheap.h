@@ -0,0 +1,68 @@
+/*
+ * pageheap.h - page-level heap of spans
+ *
+ * The page heap hands out spans, runs of whole pages, for whoever owns
+ * them next (see SPAN_* in pagemap.h), and takes them back. Free runs
+ * are merged with free neighbors on release. Runs shorter than
+ * PH_MAXPAGES pages are kept on one list per length, with a bitmap of
+ * the lists that are not empty, so the shortest run that fits is found
+ * with a bit scan; longer runs share one list searched best fit. A run
+ * longer than the request is split and the rest goes back on its list.
+ *
+ * Only the first and last page of a free run are mapped to it in the
+ * page map; every page of a span in use must be mapped by its owner.
+ *
+ * Free runs decay: pageheap_purge, called now and then with the time
+ * in whatever unit the caller counts, gives the pages of runs that
+ * have been free for longer than the decay interval back to the OS.
+ * A run freed between two calls counts as freed at the earlier one.
+ * Pages of a purged run that are handed out again are counted as
+ * refaulted; for a run only partly purged, the purged pages are taken
+ * to be the ones handed out first.
+ */
+#ifndef __PAGEHEAP_H_
+#define __PAGEHEAP_H_
+
+#include "pagemap.h"
+
+#define PH_MAXPAGES 128
+
+/* Forget all free runs; for a new heap */
+void pageheap_init(void);
+
+/*
+ * Take a span of npages pages from the free runs, or NULL if no run is
+ * long enough. The span is not mapped and its kind is not set.
+ */
+span_t *pageheap_alloc(size_t npages);
+
+/*
+ * Take a span of npages new pages at the end of the heap, or NULL if
+ * the heap is full. A free run that ends the heap is extended instead.
+ * The heap must end on a page boundary.
+ */
+span_t *pageheap_sbrk(size_t npages);
+
+/*
+ * Grow span s in place to npages pages, from the free run after it or
+ * from the end of the heap, and map the new pages to s. Returns 0, or
+ * -1 if there is no room after s.
+ */
+int pageheap_grow(span_t *s, size_t npages);
+
+/* Give span s back as a free run */
+void pageheap_free(span_t *s);
+
+/*
+ * Purge the free runs that have been free since before now - decay.
+ * Returns the number of bytes purged.
+ */
+size_t pageheap_purge(unsigned long now, unsigned long decay);
+
+/* Bytes purged and refaulted since pageheap_init */
+void pageheap_counts(size_t *purged, size_t *refaulted);
+
+/* Bytes in free runs, and in the longest free run */
+void pageheap_stats(size_t *free_bytes, size_t *largest);
+
+#endif /* __PAGEHEAP_H_ */
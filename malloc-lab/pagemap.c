@@ -0,0 +1,112 @@
+/*
+ * pagemap.c - radix tree from pages to span descriptors
+ *
+ * Leaves are mapped on first use and kept across pagemap_init, which
+ * only clears them, since mdriver restarts the heap for every run of
+ * every trace. Descriptors are cut from chunks mapped the same way and
+ * recycled through a free list.
+ */
+#include <string.h>
+#include <sys/mman.h>
+#include "pagemap.h"
+
+#define LEAF_SIZE ((1 << PM_LEAF_BITS) * sizeof(span_t *))
+#define META_CHUNK (64 * 1024)   /* bytes of descriptors mapped at a time */
+
+char *pagemap_base;
+span_t **pagemap_root[1 << PM_ROOT_BITS];
+
+/* Descriptor chunks are chained through their first word */
+static char *meta_first;         /* first chunk mapped */
+static char *meta_chunk;         /* chunk being cut */
+static size_t meta_used;         /* bytes of it handed out */
+static span_t *span_freelist;    /* released descriptors */
+
+/*
+ * map_meta - Map n bytes of zeroed memory for metadata; NULL on failure.
+ */
+static void *map_meta(size_t n)
+{
+    void *p = mmap(NULL, n, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return p == MAP_FAILED ? NULL : p;
+}
+
+/*
+ * pagemap_init - Clear the map and take back every descriptor
+ */
+void pagemap_init(void *base)
+{
+    int i;
+
+    pagemap_base = base;
+    for (i = 0; i < (1 << PM_ROOT_BITS); i++)
+        if (pagemap_root[i] != NULL)
+            memset(pagemap_root[i], 0, LEAF_SIZE);
+    meta_chunk = meta_first;
+    meta_used = sizeof(char *);
+    span_freelist = NULL;
+}
+
+/*
+ * pagemap_set - Map npages pages from p to s, adding leaves as needed
+ */
+int pagemap_set(void *p, size_t npages, span_t *s)
+{
+    size_t page = (size_t)((char *)p - pagemap_base) >> PM_PAGE_SHIFT;
+    size_t end = page + npages, i;
+    span_t **leaf;
+
+    for (; page < end; page++) {
+        i = page >> PM_LEAF_BITS;
+        if ((leaf = pagemap_root[i]) == NULL) {
+            if ((leaf = map_meta(LEAF_SIZE)) == NULL)
+                return -1;
+            pagemap_root[i] = leaf;
+        }
+        leaf[page & ((1 << PM_LEAF_BITS) - 1)] = s;
+    }
+    return 0;
+}
+
+/*
+ * span_new - A zeroed descriptor, from the free list or the current
+ *     chunk; a new chunk is mapped when the chained ones are used up.
+ */
+span_t *span_new(void)
+{
+    span_t *s;
+    char *next;
+
+    if ((s = span_freelist) != NULL) {
+        span_freelist = s->next;
+    } else {
+        if (meta_chunk == NULL || meta_used + sizeof(span_t) > META_CHUNK) {
+            next = meta_chunk ? *(char **)meta_chunk : NULL;
+            if (next == NULL) {
+                if ((next = map_meta(META_CHUNK)) == NULL)
+                    return NULL;
+                if (meta_chunk)
+                    *(char **)meta_chunk = next;
+                else
+                    meta_first = next;
+            }
+            meta_chunk = next;
+            meta_used = sizeof(char *);
+        }
+        s = (span_t *)(meta_chunk + meta_used);
+        meta_used += sizeof(span_t);
+    }
+    memset(s, 0, sizeof(span_t));
+    return s;
+}
+
+/*
+ * span_delete - Put a descriptor back on the free list
+ */
+void span_delete(span_t *s)
+{
+    s->next = span_freelist;
+    span_freelist = s;
+}
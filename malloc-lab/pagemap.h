@@ -0,0 +1,75 @@
+/*
+ * pagemap.h - page-to-span map for the simulated heap
+ *
+ * The heap is divided into spans, runs of whole pages that each have a
+ * descriptor outside the heap. The page map is a two-level radix tree
+ * indexed by page number that takes any heap address to the descriptor
+ * of the span holding it, in two dependent loads and without touching
+ * the heap. It reaches 4 GB above the heap base, which is as far as the
+ * 32-bit offsets of mm.c go.
+ *
+ * Leaves of the tree and span descriptors live in memory mapped
+ * directly from the OS, so they are not counted in the heap.
+ */
+#ifndef __PAGEMAP_H_
+#define __PAGEMAP_H_
+
+#include <stddef.h>
+
+#define PM_PAGE_SHIFT 12
+#define PM_PAGE (1 << PM_PAGE_SHIFT)
+#define PM_LEAF_BITS 10
+#define PM_ROOT_BITS 10
+
+/* What a span holds */
+#define SPAN_FREE 0              /* nothing; its pages can be reused */
+#define SPAN_BLOCKS 1            /* a segment of boundary-tag blocks */
+#define SPAN_LARGE 2             /* one large allocation */
+#define SPAN_SLAB 3              /* objects of one size class, no headers */
+
+typedef struct span {
+    char *start;                 /* first byte, page aligned */
+    size_t npages;               /* length in pages */
+    int kind;                    /* SPAN_FREE, SPAN_BLOCKS, ... */
+    int sclass;                  /* size class of the objects it holds */
+    unsigned nfree;              /* number of those objects that are free */
+    char *objs;                  /* freed objects, linked through their first word */
+    char *bump;                  /* first object never handed out */
+    unsigned long idle;          /* free run: decay clock when it was freed */
+    size_t npurged;              /* free run: pages given back to the OS */
+    struct span *next;           /* list links, for the span's owner */
+    struct span *prev;
+} span_t;
+
+/* The tree, for pagemap_get */
+extern char *pagemap_base;
+extern span_t **pagemap_root[1 << PM_ROOT_BITS];
+
+/*
+ * Start an empty map for a heap at base, a page boundary. All span
+ * descriptors handed out before are released.
+ */
+void pagemap_init(void *base);
+
+/*
+ * Map the npages pages from p onwards to s. Returns 0, or -1 if a leaf
+ * could not be allocated.
+ */
+int pagemap_set(void *p, size_t npages, span_t *s);
+
+/* Get a zeroed span descriptor (NULL if out of memory), and release one */
+span_t *span_new(void);
+void span_delete(span_t *s);
+
+/*
+ * The span holding heap address p. The page must have been mapped
+ * with pagemap_set since the last pagemap_init.
+ */
+static inline span_t *pagemap_get(const void *p)
+{
+    size_t page = (size_t)((const char *)p - pagemap_base) >> PM_PAGE_SHIFT;
+
+    return pagemap_root[page >> PM_LEAF_BITS][page & ((1 << PM_LEAF_BITS) - 1)];
+}
+
+#endif /* __PAGEMAP_H_ */
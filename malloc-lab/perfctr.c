@@ -0,0 +1,162 @@
+/*
+ * perfctr.c - hardware performance counters via perf_event_open
+ *
+ * On systems without perf events (or with a perf_event_paranoid
+ * setting that forbids them) perfctr_init() simply reports zero
+ * available events and the driver prints dashes.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "perfctr.h"
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static int fds[PERFCTR_NEVENTS] = {-1, -1, -1, -1, -1, -1};
+
+static const char *names[PERFCTR_NEVENTS] = {
+    "cycles", "instr", "L1d-miss", "LLC-miss", "dTLB-miss", "br-miss"
+};
+
+#ifdef __linux__
+
+/* Hardware cache event config: cache id, op and result packed together */
+#define CACHE_EVENT(id, op, res) \
+    ((id) | ((op) << 8) | ((res) << 16))
+
+static const struct {
+    unsigned type;
+    unsigned long long config;
+} events[PERFCTR_NEVENTS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D,
+				     PERF_COUNT_HW_CACHE_OP_READ,
+				     PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB,
+				     PERF_COUNT_HW_CACHE_OP_READ,
+				     PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+/*
+ * open_event - open one counting event on this process, any CPU
+ */
+static int open_event(int i)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[i].type;
+    attr.config = events[i].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+	PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * perfctr_init - Open the counters; returns the number of events available
+ */
+int perfctr_init(void)
+{
+    int i, n = 0;
+
+    for (i = 0; i < PERFCTR_NEVENTS; i++) {
+	if (fds[i] < 0)
+	    fds[i] = open_event(i);
+	if (fds[i] >= 0)
+	    n++;
+    }
+    return n;
+}
+
+/*
+ * perfctr_start - Zero and start all available counters
+ */
+void perfctr_start(void)
+{
+    int i;
+
+    for (i = 0; i < PERFCTR_NEVENTS; i++)
+	if (fds[i] >= 0)
+	    ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+    for (i = 0; i < PERFCTR_NEVENTS; i++)
+	if (fds[i] >= 0)
+	    ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+}
+
+/*
+ * perfctr_stop - Stop the counters and store the counts. When the
+ *     kernel multiplexed an event it only ran for part of the region,
+ *     so we scale the raw count by enabled/running time.
+ */
+void perfctr_stop(double *counts)
+{
+    unsigned long long buf[3]; /* value, time enabled, time running */
+    int i;
+
+    for (i = 0; i < PERFCTR_NEVENTS; i++)
+	if (fds[i] >= 0)
+	    ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    for (i = 0; i < PERFCTR_NEVENTS; i++) {
+	counts[i] = -1;
+	if (fds[i] < 0 || read(fds[i], buf, sizeof(buf)) != sizeof(buf))
+	    continue;
+	if (buf[2] == 0)
+	    counts[i] = 0;
+	else
+	    counts[i] = (double)buf[0] * ((double)buf[1] / (double)buf[2]);
+    }
+}
+
+#else /* !__linux__ */
+
+int perfctr_init(void)
+{
+    return 0;
+}
+
+void perfctr_start(void)
+{
+}
+
+void perfctr_stop(double *counts)
+{
+    int i;
+
+    for (i = 0; i < PERFCTR_NEVENTS; i++)
+	counts[i] = -1;
+}
+
+#endif /* __linux__ */
+
+/*
+ * perfctr_deinit - Release the counters
+ */
+void perfctr_deinit(void)
+{
+    int i;
+
+    for (i = 0; i < PERFCTR_NEVENTS; i++) {
+	if (fds[i] >= 0)
+	    close(fds[i]);
+	fds[i] = -1;
+    }
+}
+
+/*
+ * perfctr_name - Short name of event i, for table headers
+ */
+const char *perfctr_name(int i)
+{
+    return names[i];
+}
@@ -0,0 +1,36 @@
+/*
+ * perfctr.h - hardware performance counters around a measured region
+ *
+ * A thin wrapper over Linux perf_event_open(2). Each event is opened
+ * on its own so that an event the CPU or kernel does not support only
+ * loses that one column. Counts are user-mode only and are scaled up
+ * when the kernel had to multiplex the counters.
+ */
+#ifndef __PERFCTR_H_
+#define __PERFCTR_H_
+
+/* The events we count, in reporting order */
+#define PC_CYCLES        0
+#define PC_INSTRUCTIONS  1
+#define PC_L1D_MISSES    2
+#define PC_LLC_MISSES    3
+#define PC_DTLB_MISSES   4
+#define PC_BRANCH_MISSES 5
+#define PERFCTR_NEVENTS  6
+
+/* Open the counters; returns the number of events available */
+int perfctr_init(void);
+
+/* Release the counters */
+void perfctr_deinit(void);
+
+/* Zero and start all available counters */
+void perfctr_start(void);
+
+/* Stop the counters and store the counts; unavailable events get -1 */
+void perfctr_stop(double *counts);
+
+/* Short name of event i, for table headers */
+const char *perfctr_name(int i);
+
+#endif /* __PERFCTR_H_ */
@@ -0,0 +1,138 @@
+/*
+ * region.c - regions: objects bumped out of chunks taken from
+ *     mm_malloc, all freed together
+ *
+ * A region hands out memory by advancing a pointer through its current
+ * chunk. When that runs out it takes a new chunk, twice as big as the
+ * last up to CHUNK_MAX; a request too big to share a chunk gets one of
+ * its own. Objects cannot be freed one by one. mm_region_reset frees
+ * every chunk but the current one and starts bumping it from the
+ * beginning again, so the cost of a reset does not depend on the
+ * number of objects, and a region reused for one request after another
+ * settles on a single chunk.
+ */
+#include <stddef.h>
+
+#include "mm.h"
+
+#define ALIGNMENT 8
+#define ALIGN(n) (((n) + (ALIGNMENT - 1)) & ~(size_t)(ALIGNMENT - 1))
+
+#define CHUNK_MIN 4096           /* the first chunk */
+#define CHUNK_MAX (64 * 1024)    /* chunks double up to this */
+
+/* The start of every chunk, followed by its objects */
+typedef struct chunk {
+    struct chunk *next;
+    size_t size;                 /* bytes, including this header */
+} chunk_t;
+
+struct mm_region {
+    chunk_t *chunks;             /* the current chunk first */
+    char *bump;                  /* next free byte of the current chunk */
+    char *end;                   /* and its end */
+    size_t next_size;            /* size of the next shared chunk */
+};
+
+static void *region_grow(mm_region_t *r, size_t size);
+
+/*
+ * mm_region_create - An empty region, or NULL if out of memory
+ */
+mm_region_t *mm_region_create(void)
+{
+    mm_region_t *r;
+
+    if ((r = mm_malloc(sizeof(*r))) == NULL)
+        return NULL;
+    r->chunks = NULL;
+    r->bump = r->end = NULL;
+    r->next_size = CHUNK_MIN;
+    return r;
+}
+
+/*
+ * mm_region_alloc - size bytes from region r, 8-byte aligned
+ */
+void *mm_region_alloc(mm_region_t *r, size_t size)
+{
+    char *p;
+
+    if (size == 0)
+        return NULL;
+    size = ALIGN(size);
+    if (size > (size_t)(r->end - r->bump))
+        return region_grow(r, size);
+    p = r->bump;
+    r->bump += size;
+    return p;
+}
+
+/*
+ * region_grow - Allocate size bytes from a new chunk: a chunk of their
+ *     own if they would take more than a quarter of a shared chunk,
+ *     otherwise the next shared chunk, which becomes the current one.
+ */
+static void *region_grow(mm_region_t *r, size_t size)
+{
+    size_t csize = r->next_size;
+    chunk_t *c;
+
+    if (size > csize / 4) {
+        if ((c = mm_malloc(sizeof(chunk_t) + size)) == NULL)
+            return NULL;
+        c->size = sizeof(chunk_t) + size;
+        if (r->chunks != NULL) {
+            /* Behind the current chunk, which keeps bumping */
+            c->next = r->chunks->next;
+            r->chunks->next = c;
+        } else {
+            c->next = NULL;
+            r->chunks = c;
+        }
+        return c + 1;
+    }
+
+    if ((c = mm_malloc(csize)) == NULL)
+        return NULL;
+    c->size = csize;
+    c->next = r->chunks;
+    r->chunks = c;
+    if (csize < CHUNK_MAX)
+        r->next_size = csize * 2;
+    r->bump = (char *)(c + 1) + size;
+    r->end = (char *)c + csize;
+    return c + 1;
+}
+
+/*
+ * mm_region_reset - Free everything allocated from r. The current
+ *     chunk is kept for what r allocates next.
+ */
+void mm_region_reset(mm_region_t *r)
+{
+    chunk_t *c = r->chunks, *next;
+
+    if (c == NULL)
+        return;
+    for (next = c->next; next != NULL; next = c->next) {
+        c->next = next->next;
+        mm_free(next);
+    }
+    r->bump = (char *)(c + 1);
+    r->end = (char *)c + c->size;
+}
+
+/*
+ * mm_region_destroy - Free r and everything allocated from it
+ */
+void mm_region_destroy(mm_region_t *r)
+{
+    chunk_t *c, *next;
+
+    for (c = r->chunks; c != NULL; c = next) {
+        next = c->next;
+        mm_free(c);
+    }
+    mm_free(r);
+}
@@ -0,0 +1,141 @@
+/*
+ * regionbench.c - compare freeing objects one by one with resetting a
+ *     region
+ *
+ * Replays a request-handler workload on the mm.c heap: each of -n
+ * requests allocates -k objects, mostly small with now and then one of
+ * a few KB, writes to each, and then releases all of them. The
+ * release is timed both ways: mm_malloc and mm_free per object, and
+ * mm_region_alloc from one region that is reset after every request.
+ * Prints the cycles per object, with the allocation included, and the
+ * heap size each way ended with.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "fcyc.h"
+#include "memlib.h"
+#include "mm.h"
+
+/* The workload, the same for both ways */
+typedef struct {
+    int requests;
+    int objects;                 /* per request */
+    size_t *sizes;               /* objects of them all */
+    void **ptrs;                 /* objects of one request */
+} work_t;
+
+static void start_heap(void)
+{
+    mem_reset_brk();
+    if (mm_init() < 0) {
+        fprintf(stderr, "regionbench: mm_init failed\n");
+        exit(1);
+    }
+}
+
+static void run_free(void *arg)
+{
+    work_t *w = (work_t *)arg;
+    size_t *size = w->sizes;
+    int i, j;
+
+    start_heap();
+    for (i = 0; i < w->requests; i++) {
+        for (j = 0; j < w->objects; j++, size++) {
+            if ((w->ptrs[j] = mm_malloc(*size)) == NULL) {
+                fprintf(stderr, "regionbench: mm_malloc failed\n");
+                exit(1);
+            }
+            *(char *)w->ptrs[j] = (char)j;
+        }
+        for (j = 0; j < w->objects; j++)
+            mm_free(w->ptrs[j]);
+    }
+}
+
+static void run_region(void *arg)
+{
+    work_t *w = (work_t *)arg;
+    size_t *size = w->sizes;
+    mm_region_t *r;
+    char *p;
+    int i, j;
+
+    start_heap();
+    if ((r = mm_region_create()) == NULL) {
+        fprintf(stderr, "regionbench: mm_region_create failed\n");
+        exit(1);
+    }
+    for (i = 0; i < w->requests; i++) {
+        for (j = 0; j < w->objects; j++, size++) {
+            if ((p = mm_region_alloc(r, *size)) == NULL) {
+                fprintf(stderr, "regionbench: mm_region_alloc failed\n");
+                exit(1);
+            }
+            *p = (char)j;
+        }
+        mm_region_reset(r);
+    }
+    mm_region_destroy(r);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: regionbench [-n <requests>] [-k <objects>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-n <requests>  Requests to replay (default 100).\n");
+    fprintf(stderr, "\t-k <objects>   Objects per request (default 1000).\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    work_t w;
+    double cyc;
+    long i, n;
+    int opt;
+
+    w.requests = 100;
+    w.objects = 1000;
+    while ((opt = getopt(argc, argv, "n:k:h")) != EOF) {
+	switch (opt) {
+	case 'n': w.requests = atoi(optarg); break;
+	case 'k': w.objects = atoi(optarg); break;
+	default: usage();
+	}
+    }
+    if (w.requests < 1 || w.objects < 1)
+	usage();
+
+    n = (long)w.requests * w.objects;
+    if ((w.sizes = malloc(n * sizeof(size_t))) == NULL ||
+	(w.ptrs = malloc(w.objects * sizeof(void *))) == NULL) {
+	fprintf(stderr, "regionbench: out of memory\n");
+	exit(1);
+    }
+    srand(1);
+    for (i = 0; i < n; i++)
+	w.sizes[i] = (rand() % 64 == 0) ? 1024 + rand() % 4096 : 8 + rand() % 248;
+
+    mem_init();
+    set_fcyc_k(3);
+    set_fcyc_epsilon(0.01);
+    set_fcyc_maxsamples(20);
+    set_fcyc_compensate(0);
+
+    printf("%d requests of %d objects\n", w.requests, w.objects);
+    printf("%-22s %12s %10s\n", "", "cycles/obj", "heap");
+    cyc = fcyc(run_free, &w);
+    printf("%-22s %12.1f %10lu\n", "mm_malloc + mm_free", cyc / n,
+	   (unsigned long)mem_heapsize());
+    cyc = fcyc(run_region, &w);
+    printf("%-22s %12.1f %10lu\n", "region alloc + reset", cyc / n,
+	   (unsigned long)mem_heapsize());
+
+    mem_deinit();
+    free(w.sizes);
+    free(w.ptrs);
+    return 0;
+}
@@ -0,0 +1,354 @@
+/*
+ * analyze_trace.c - workload statistics for Malloc Lab traces
+ *
+ * Makes one pass over each trace (text or binary) and reports
+ *   - request sizes, as a power-of-two histogram,
+ *   - object lifetimes, in requests from malloc to free,
+ *   - peak live bytes and objects,
+ *   - realloc growth chains: how often objects are resized and by
+ *     how much in total,
+ *   - size-class reuse distance: the number of requests between a
+ *     free and the next malloc of a block of the same size class,
+ * and finally suggests a size-class table for a segregated allocator,
+ * fitted to the block sizes of all the traces together.
+ *
+ * Per-object state is a few words per request id, so memory grows
+ * with the number of ids in a trace, not with its length.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tracefile.h"
+#include "sizeclass.h"
+
+#define NBUCKETS 48        /* power-of-two histogram buckets */
+#define NREUSE   1024      /* exact reuse classes, one per 8-byte block size ... */
+#define NCLASSES (NREUSE + NBUCKETS) /* ... then one per power of two */
+
+/* A power-of-two histogram: bucket b holds values in [2^(b-1), 2^b) */
+typedef struct {
+    double count[NBUCKETS];
+    double bytes[NBUCKETS];
+    double n;
+} loghist_t;
+
+/* Per-object state */
+typedef struct {
+    long long born;        /* request number of the malloc, -1 if not live */
+    unsigned size;         /* current size */
+    unsigned first;        /* size at malloc */
+    unsigned resizes;      /* reallocs so far */
+} obj_t;
+
+static double *sizes = NULL;  /* block size histogram over all traces */
+static int maxblock = 4096;   /* largest block size that gets a class */
+
+/*
+ * bucket - the power-of-two bucket for v
+ */
+static int bucket(unsigned long long v)
+{
+    int b = 0;
+
+    while (v != 0 && b < NBUCKETS - 1) {
+	v >>= 1;
+	b++;
+    }
+    return b;
+}
+
+/* hist_add - count v, which stands for bytes bytes, in h */
+static void hist_add(loghist_t *h, unsigned long long v, double bytes)
+{
+    int b = bucket(v);
+
+    h->count[b]++;
+    h->bytes[b] += bytes;
+    h->n++;
+}
+
+/*
+ * size_class - the class used to measure reuse distance: blocks up to
+ *     NREUSE*8 bytes by exact block size, larger ones by power of two
+ */
+static int size_class(unsigned size)
+{
+    unsigned long long asize = SC_BLOCKSIZE((unsigned long long)size);
+
+    if (asize / SC_GRAIN < NREUSE)
+	return (int)(asize / SC_GRAIN);
+    return NREUSE + bucket(asize);
+}
+
+/*
+ * print_hist - print the non-empty buckets of h
+ */
+static void print_hist(const char *title, const char *unit, loghist_t *h,
+		       int show_bytes)
+{
+    unsigned long long lo;
+    double cum = 0, bytes = 0;
+    int b;
+
+    for (b = 0; b < NBUCKETS; b++)
+	bytes += h->bytes[b];
+    printf("\n%s\n", title);
+    printf("  %21s %12s %7s %7s%s\n", unit, "count", "pct", "cum",
+	   show_bytes ? "    bytes" : "");
+    for (b = 0; b < NBUCKETS; b++) {
+	if (h->count[b] == 0)
+	    continue;
+	cum += h->count[b];
+	lo = b ? 1ULL << (b - 1) : 0;
+	printf("  %10llu-%-10llu %12.0f %6.2f%% %6.2f%%",
+	       lo, b ? (1ULL << b) - 1 : 0, h->count[b],
+	       100 * h->count[b] / h->n, 100 * cum / h->n);
+	if (show_bytes)
+	    printf(" %8.2f%%", bytes ? 100 * h->bytes[b] / bytes : 0);
+	printf("\n");
+    }
+}
+
+/*
+ * analyze - make one pass over a trace and print its statistics
+ */
+static int analyze(char *path)
+{
+    tracefile_t *tf;
+    tf_op_t op;
+    obj_t *obj, *o;
+    loghist_t reqsize, lifetime, chains, reuse;
+    long long t = 0, peak_t = 0;
+    double live = 0, peak = 0, npeak = 0, nlive = 0, reqbytes = 0;
+    double counts[3] = {0, 0, 0}, grows = 0, shrinks = 0, ratio = 0, nchains = 0;
+    double fresh = 0;
+    long long *last_free;
+    unsigned *pending, k, n;
+    int rc, c;
+
+    if ((tf = tf_open(path)) == NULL) {
+	fprintf(stderr, "analyze_trace: cannot read %s\n", path);
+	return -1;
+    }
+    obj = (obj_t *)malloc((tf->num_ids + 1) * sizeof(obj_t));
+    last_free = (long long *)calloc(NCLASSES, sizeof(long long));
+    pending = (unsigned *)calloc(NCLASSES, sizeof(unsigned));
+    if (obj == NULL || last_free == NULL || pending == NULL) {
+	fprintf(stderr, "analyze_trace: out of memory\n");
+	exit(1);
+    }
+    for (c = 0; c <= tf->num_ids; c++)
+	obj[c].born = -1;
+    memset(&reqsize, 0, sizeof(reqsize));
+    memset(&lifetime, 0, sizeof(lifetime));
+    memset(&chains, 0, sizeof(chains));
+    memset(&reuse, 0, sizeof(reuse));
+
+    while ((rc = tf_next(tf, &op)) > 0) {
+	/* A batch counts as n requests on consecutive ids */
+	n = (op.type == 'A' || op.type == 'F') ? op.count : 1;
+	if (op.index >= tf->num_ids || n > tf->num_ids - op.index) {
+	    fprintf(stderr, "analyze_trace: %s:%lld: id %u out of range\n",
+		    path, tf->line, op.index);
+	    rc = -2;
+	    break;
+	}
+	for (k = 0; k < n; k++) {
+	    t++;
+	    o = &obj[op.index + k];
+	    switch (op.type) {
+	    case 'a':
+	    case 'c':
+	    case 'm':
+	    case 'A':
+		counts[0]++;
+		o->born = t;
+		o->size = o->first = op.size;
+		o->resizes = 0;
+		live += op.size;
+		nlive++;
+		reqbytes += op.size;
+		hist_add(&reqsize, op.size, op.size);
+		if (SC_BLOCKSIZE(op.size) <= (unsigned)maxblock)
+		    sizes[SC_BLOCKSIZE(op.size) / SC_GRAIN]++;
+
+		/* Distance back to the latest free of this class */
+		c = size_class(op.size);
+		if (pending[c] > 0) {
+		    hist_add(&reuse, t - last_free[c], 0);
+		    pending[c]--;
+		} else {
+		    fresh++;
+		}
+		break;
+	    case 'r':
+		counts[1]++;
+		if (o->born < 0)
+		    break;
+		if (op.size > o->size)
+		    grows++;
+		else if (op.size < o->size)
+		    shrinks++;
+		live += (double)op.size - o->size;
+		reqbytes += op.size;
+		hist_add(&reqsize, op.size, op.size);
+		if (SC_BLOCKSIZE(op.size) <= (unsigned)maxblock)
+		    sizes[SC_BLOCKSIZE(op.size) / SC_GRAIN]++;
+		o->size = op.size;
+		o->resizes++;
+		break;
+	    case 'f':
+	    case 'F':
+		counts[2]++;
+		if (o->born < 0)
+		    break;
+		hist_add(&lifetime, t - o->born, 0);
+		if (o->resizes > 0) {
+		    hist_add(&chains, o->resizes, 0);
+		    ratio += o->first ? (double)o->size / o->first : 1;
+		    nchains++;
+		}
+		c = size_class(o->size);
+		last_free[c] = t;
+		pending[c]++;
+		live -= o->size;
+		nlive--;
+		o->born = -1;
+		break;
+	    default:
+		fprintf(stderr, "analyze_trace: %s:%lld: bad request type '%c'\n",
+			path, tf->line, op.type);
+		rc = -2;
+		break;
+	    }
+	    if (rc < 0)
+		break;
+	    if (live > peak) {
+		peak = live;
+		peak_t = t;
+	    }
+	    if (nlive > npeak)
+		npeak = nlive;
+	}
+	if (rc < 0)
+	    break;
+    }
+    if (rc == -1)
+	fprintf(stderr, "analyze_trace: %s:%lld: malformed request\n",
+		path, tf->line);
+    if (rc < 0) {
+	tf_close(tf);
+	free(obj);
+	free(last_free);
+	free(pending);
+	return -1;
+    }
+
+    printf("==> %s\n", path);
+    printf("requests: %lld (%.0f malloc/calloc/memalign, %.0f realloc, %.0f free), ids: %lld\n",
+	   t, counts[0], counts[1], counts[2], tf->num_ids);
+    printf("bytes requested: %.0f, mean request %.1f bytes\n", reqbytes,
+	   reqsize.n ? reqbytes / reqsize.n : 0);
+    printf("peak live: %.0f bytes at request %lld, %.0f objects\n",
+	   peak, peak_t, npeak);
+    printf("never freed: %.0f objects, %.0f bytes\n", nlive, live);
+
+    print_hist("Request sizes (allocations and reallocs)", "bytes", &reqsize, 1);
+    print_hist("Lifetimes (requests from malloc to free)", "requests",
+	       &lifetime, 0);
+
+    printf("\nRealloc: %.0f grow, %.0f shrink, %.0f same size\n",
+	   grows, shrinks, counts[1] - grows - shrinks);
+    if (nchains > 0) {
+	printf("  %.0f objects were resized; final/initial size %.2fx on average\n",
+	       nchains, ratio / nchains);
+	print_hist("Realloc chain lengths (reallocs per object)", "reallocs",
+		   &chains, 0);
+    }
+
+    printf("\nSize-class reuse: %.0f of %.0f mallocs found a freed block of their class\n",
+	   reuse.n, reuse.n + fresh);
+    if (reuse.n > 0)
+	print_hist("Reuse distance (requests since the latest free in the class)",
+		   "requests", &reuse, 0);
+    printf("\n");
+
+    tf_close(tf);
+    free(obj);
+    free(last_free);
+    free(pending);
+    return 0;
+}
+
+/*
+ * suggest - print a size-class table fitted to all traces read
+ */
+static void suggest(int kmax, double waste_frac)
+{
+    unsigned *classes;
+    double waste, total = 0, lo;
+    int n = maxblock / SC_GRAIN, k, i;
+
+    for (i = 0; i <= n; i++)
+	total += sizes[i] * i * SC_GRAIN;
+    if ((classes = (unsigned *)malloc(kmax * sizeof(unsigned))) == NULL ||
+	(k = sc_choose(sizes, n, kmax, waste_frac, classes, &waste)) < 0) {
+	fprintf(stderr, "analyze_trace: out of memory\n");
+	exit(1);
+    }
+    printf("Suggested size classes for blocks up to %d bytes: %d classes,\n"
+	   "internal fragmentation %.0f bytes (%.2f%% of block bytes)\n",
+	   maxblock, k, waste, total ? 100 * waste / total : 0);
+    printf("  %6s %15s %12s\n", "class", "block bytes", "requests");
+    for (i = 0, lo = SC_MINBLOCK; i < k; i++) {
+	double cnt = 0;
+	unsigned s;
+
+	for (s = (unsigned)lo; s <= classes[i]; s += SC_GRAIN)
+	    cnt += sizes[s / SC_GRAIN];
+	printf("  %6d %6.0f-%-8u %12.0f\n", i, lo, classes[i], cnt);
+	lo = classes[i] + SC_GRAIN;
+    }
+    free(classes);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: analyze_trace [-k <classes>] [-m <bytes>] [-w <frac>] <trace>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-k <n>      At most n suggested size classes (default 32).\n");
+    fprintf(stderr, "\t-m <bytes>  Largest block size to classify (default 4096).\n");
+    fprintf(stderr, "\t-w <frac>   Use the fewest classes that waste at most this\n"
+	    "\t            fraction of block bytes (default 0.02).\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int kmax = 32, c, errors = 0;
+    double waste_frac = 0.02;
+
+    while ((c = getopt(argc, argv, "k:m:w:h")) != EOF) {
+	switch (c) {
+	case 'k': kmax = atoi(optarg); break;
+	case 'm': maxblock = atoi(optarg); break;
+	case 'w': waste_frac = atof(optarg); break;
+	default: usage();
+	}
+    }
+    if (optind == argc || kmax < 1 || maxblock < SC_MINBLOCK)
+	usage();
+    maxblock &= ~(SC_GRAIN - 1);
+    if ((sizes = (double *)calloc(maxblock / SC_GRAIN + 1, sizeof(double))) == NULL) {
+	fprintf(stderr, "analyze_trace: out of memory\n");
+	exit(1);
+    }
+    for (; optind < argc; optind++)
+	if (analyze(argv[optind]) < 0)
+	    errors++;
+    suggest(kmax, waste_frac);
+    free(sizes);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * gen_sizeclass.c - generate the size-class table compiled into mm.c
+ *
+ * Reads one or more traces, histograms the block size of every
+ * allocation and realloc request, fits a class table to it with
+ * sc_choose() and writes a C header with the class sizes and a lookup
+ * table from block size to class, so that mm.c classifies a request
+ * with one array access.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tracefile.h"
+#include "sizeclass.h"
+
+/*
+ * add_trace - add the block sizes requested by a trace to hist
+ */
+static void add_trace(char *path, double *hist, unsigned maxblock)
+{
+    tracefile_t *tf;
+    tf_op_t op;
+    unsigned long long asize;
+    int rc;
+
+    if ((tf = tf_open(path)) == NULL) {
+	fprintf(stderr, "gen_sizeclass: cannot read %s\n", path);
+	exit(1);
+    }
+    while ((rc = tf_next(tf, &op)) > 0) {
+	if (op.type == 'f' || op.type == 'F')
+	    continue;
+	asize = SC_BLOCKSIZE((unsigned long long)op.size);
+	if (asize <= maxblock)
+	    hist[asize / SC_GRAIN] += (op.type == 'A') ? op.count : 1;
+    }
+    if (rc < 0) {
+	fprintf(stderr, "gen_sizeclass: %s:%lld: malformed request\n",
+		path, tf->line);
+	exit(1);
+    }
+    tf_close(tf);
+}
+
+/*
+ * write_header - write the class table as a C header
+ */
+static void write_header(FILE *fp, char **traces, int ntraces,
+			 unsigned *classes, int k, unsigned maxblock,
+			 double waste, double total)
+{
+    unsigned s;
+    int i, c;
+
+    fprintf(fp, "/*\n * mm_classes.h - size classes for mm.c\n *\n");
+    fprintf(fp, " * Generated by traces/gen_sizeclass from\n");
+    for (i = 0; i < ntraces; i++)
+	fprintf(fp, " *   %s\n", traces[i]);
+    fprintf(fp, " * Rounding to these classes wastes %.2f%% of the block bytes of\n"
+	    " * those traces. Do not edit; run \"make classes\" to regenerate.\n */\n",
+	    total ? 100 * waste / total : 0);
+    fprintf(fp, "#ifndef __MM_CLASSES_H_\n#define __MM_CLASSES_H_\n\n");
+    fprintf(fp, "/* Number of classes, and the largest block size they cover */\n");
+    fprintf(fp, "#define MM_NCLASSES %d\n", k);
+    fprintf(fp, "#define MM_CLASS_MAXBLOCK %u\n\n", maxblock);
+
+    fprintf(fp, "/* Block size of each class */\n");
+    fprintf(fp, "static const unsigned int mm_class_size[MM_NCLASSES] = {");
+    for (i = 0; i < k; i++)
+	fprintf(fp, "%s%u", i % 8 ? ", " : (i ? ",\n    " : "\n    "), classes[i]);
+    fprintf(fp, "\n};\n\n");
+
+    fprintf(fp, "/* Smallest class holding a block of each size, indexed by size / %d */\n",
+	    SC_GRAIN);
+    fprintf(fp, "static const unsigned char mm_class_index[MM_CLASS_MAXBLOCK / %d + 1] = {",
+	    SC_GRAIN);
+    for (s = 0, c = 0; s <= maxblock; s += SC_GRAIN) {
+	while (classes[c] < s)
+	    c++;
+	fprintf(fp, "%s%d", (s / SC_GRAIN) % 16 ? ", " : (s ? ",\n    " : "\n    "), c);
+    }
+    fprintf(fp, "\n};\n\n#endif /* __MM_CLASSES_H_ */\n");
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: gen_sizeclass [-k <classes>] [-m <bytes>] [-w <frac>] -o <header> <trace>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-k <n>      At most n classes (default 32, at most 255).\n");
+    fprintf(stderr, "\t-m <bytes>  Largest block size with a class (default 4096).\n");
+    fprintf(stderr, "\t-o <file>   Header to write.\n");
+    fprintf(stderr, "\t-w <frac>   Use the fewest classes that waste at most this\n"
+	    "\t            fraction of block bytes (default 0.02).\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    char *outfile = NULL;
+    unsigned maxblock = 4096, *classes;
+    double *hist, waste, total = 0, waste_frac = 0.02;
+    int kmax = 32, k, c, i;
+    FILE *fp;
+
+    while ((c = getopt(argc, argv, "k:m:o:w:h")) != EOF) {
+	switch (c) {
+	case 'k': kmax = atoi(optarg); break;
+	case 'm': maxblock = (unsigned)atoi(optarg); break;
+	case 'o': outfile = optarg; break;
+	case 'w': waste_frac = atof(optarg); break;
+	default: usage();
+	}
+    }
+    maxblock &= ~(SC_GRAIN - 1);
+    if (optind == argc || outfile == NULL || kmax < 1 || kmax > 255 ||
+	maxblock < SC_MINBLOCK)
+	usage();
+
+    hist = (double *)calloc(maxblock / SC_GRAIN + 1, sizeof(double));
+    classes = (unsigned *)malloc(kmax * sizeof(unsigned));
+    if (hist == NULL || classes == NULL) {
+	fprintf(stderr, "gen_sizeclass: out of memory\n");
+	exit(1);
+    }
+    for (i = optind; i < argc; i++)
+	add_trace(argv[i], hist, maxblock);
+    for (i = 0; i <= (int)(maxblock / SC_GRAIN); i++)
+	total += hist[i] * i * SC_GRAIN;
+    if ((k = sc_choose(hist, maxblock / SC_GRAIN, kmax, waste_frac,
+		       classes, &waste)) < 0) {
+	fprintf(stderr, "gen_sizeclass: out of memory\n");
+	exit(1);
+    }
+
+    if ((fp = fopen(outfile, "w")) == NULL) {
+	perror(outfile);
+	exit(1);
+    }
+    write_header(fp, argv + optind, argc - optind, classes, k, maxblock,
+		 waste, total);
+    if (fclose(fp) != 0) {
+	perror(outfile);
+	exit(1);
+    }
+    printf("%s: %d classes, %.2f%% waste\n", outfile, k,
+	   total ? 100 * waste / total : 0);
+    free(hist);
+    free(classes);
+    return 0;
+}
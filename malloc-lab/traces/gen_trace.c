@@ -0,0 +1,447 @@
+/*
+ * gen_trace.c - synthesize Malloc Lab traces of arbitrary size
+ *
+ * A native replacement for the gen_*.pl scripts. Objects are allocated
+ * one after another; each gets a size from the size distribution and a
+ * lifetime, measured in allocations, from the lifetime distribution.
+ * Objects that will die (or grow) are kept in a min-heap keyed on the
+ * time of their next event, so generating n allocations costs
+ * O(n log live) time and memory proportional to the live set, and
+ * traces of 10^8 requests and more stream straight to disk. The same
+ * seed always produces the same trace.
+ *
+ * Optionally a fraction of the objects grow with realloc during their
+ * lifetime, and a target live-heap size can be imposed: when an
+ * allocation would exceed it, the objects closest to death are freed
+ * early. Every trace is balanced.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "tracefile.h"
+
+#define MAXNAME 1024
+
+/* Distribution kinds */
+#define D_UNIFORM   0   /* uniform:MIN:MAX */
+#define D_LOGNORMAL 1   /* lognormal:MEDIAN:SIGMA */
+#define D_ZIPF      2   /* zipf:S:N[:STEP] */
+#define D_BIMODAL   3   /* bimodal:A:B:P */
+#define D_EMPIRICAL 4   /* empirical:TRACEFILE */
+#define D_EXP       5   /* exp:MEAN */
+#define D_PARETO    6   /* pareto:ALPHA:MIN */
+#define D_FIXED     7   /* fixed:N */
+
+typedef struct {
+    int kind;
+    double a, b, c;       /* parameters, in the order given */
+    double *cdf;          /* zipf: cumulative probability of each rank */
+    unsigned *vals;       /* empirical: the sizes seen in the trace */
+    size_t n;             /* number of entries in cdf or vals */
+} dist_t;
+
+/* A live object, keyed in the heap by the time of its next event */
+typedef struct {
+    unsigned long long when;   /* time of the next realloc or the free */
+    unsigned long long death;  /* time of the free */
+    unsigned long long step;   /* time between reallocs */
+    unsigned id;
+    unsigned size;
+    unsigned grows;            /* reallocs still to come */
+    unsigned count;            /* ids in a batch, 0 for a single object */
+} obj_t;
+
+/* Program state */
+static obj_t *heap = NULL;       /* min-heap of live objects */
+static size_t heapn = 0, heapmax = 0;
+static unsigned long long rng;   /* xorshift64* state */
+static tracefile_t *out;
+static double live = 0, peak = 0;
+
+/*
+ * rand_u64/rand_unit - xorshift64* generator: fast, and good enough to
+ *     drive workload synthesis
+ */
+static unsigned long long rand_u64(void)
+{
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545F4914F6CDD1DULL;
+}
+
+/* Uniform in (0, 1) */
+static double rand_unit(void)
+{
+    return ((rand_u64() >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/* Standard normal, by Box-Muller */
+static double rand_normal(void)
+{
+    return sqrt(-2.0 * log(rand_unit())) * cos(6.283185307179586 * rand_unit());
+}
+
+/*
+ * sample - draw one value from a distribution
+ */
+static double sample(dist_t *d)
+{
+    size_t lo, hi, mid;
+    double u;
+
+    switch (d->kind) {
+    case D_UNIFORM:
+	return d->a + floor(rand_unit() * (d->b - d->a + 1));
+    case D_LOGNORMAL:
+	return d->a * exp(d->b * rand_normal());
+    case D_ZIPF:
+	u = rand_unit();
+	lo = 0;
+	hi = d->n - 1;
+	while (lo < hi) {
+	    mid = (lo + hi) / 2;
+	    if (d->cdf[mid] < u)
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+	return (lo + 1) * d->c;
+    case D_BIMODAL:
+	return rand_unit() < d->c ? d->a : d->b;
+    case D_EMPIRICAL:
+	return d->vals[rand_u64() % d->n];
+    case D_EXP:
+	return -d->a * log(rand_unit());
+    case D_PARETO:
+	return d->b / pow(rand_unit(), 1.0 / d->a);
+    case D_FIXED:
+	return d->a;
+    }
+    return 0;
+}
+
+/*
+ * load_empirical - collect the sizes of every allocation and realloc request
+ *     in an existing trace
+ */
+static void load_empirical(dist_t *d, const char *path)
+{
+    tracefile_t *tf;
+    tf_op_t op;
+    size_t max = 1024;
+    int rc;
+
+    if ((tf = tf_open(path)) == NULL) {
+	fprintf(stderr, "gen_trace: cannot read trace %s\n", path);
+	exit(1);
+    }
+    d->vals = (unsigned *)malloc(max * sizeof(unsigned));
+    while (d->vals != NULL && (rc = tf_next(tf, &op)) > 0) {
+	if (op.type == 'f' || op.type == 'F')
+	    continue;
+	if (d->n == max)
+	    d->vals = (unsigned *)realloc(d->vals, (max *= 2) * sizeof(unsigned));
+	if (d->vals != NULL)
+	    d->vals[d->n++] = op.size;
+    }
+    tf_close(tf);
+    if (d->vals == NULL || d->n == 0) {
+	fprintf(stderr, "gen_trace: no allocation sizes in %s\n", path);
+	exit(1);
+    }
+}
+
+/*
+ * parse_dist - parse "kind:p1:p2:p3" into d
+ */
+static void parse_dist(dist_t *d, char *spec)
+{
+    static const struct { const char *name; int kind, nparams; } kinds[] = {
+	{"uniform", D_UNIFORM, 2}, {"lognormal", D_LOGNORMAL, 2},
+	{"zipf", D_ZIPF, 2}, {"bimodal", D_BIMODAL, 3},
+	{"empirical", D_EMPIRICAL, 0}, {"exp", D_EXP, 1},
+	{"pareto", D_PARETO, 2}, {"fixed", D_FIXED, 1}, {NULL, 0, 0}
+    };
+    char *colon = strchr(spec, ':');
+    size_t len = colon ? (size_t)(colon - spec) : strlen(spec);
+    double sum = 0;
+    size_t i;
+    int k, n;
+
+    memset(d, 0, sizeof(*d));
+    for (k = 0; kinds[k].name != NULL; k++)
+	if (strlen(kinds[k].name) == len && !strncmp(spec, kinds[k].name, len))
+	    break;
+    if (kinds[k].name == NULL || colon == NULL) {
+	fprintf(stderr, "gen_trace: bad distribution \"%s\"\n", spec);
+	exit(1);
+    }
+    d->kind = kinds[k].kind;
+    if (d->kind == D_EMPIRICAL) {
+	load_empirical(d, colon + 1);
+	return;
+    }
+    d->c = 16;                  /* default zipf step */
+    n = sscanf(colon + 1, "%lf:%lf:%lf", &d->a, &d->b, &d->c);
+    if (n < kinds[k].nparams) {
+	fprintf(stderr, "gen_trace: \"%s\" needs %d parameters\n",
+		spec, kinds[k].nparams);
+	exit(1);
+    }
+    if (d->kind == D_ZIPF) {
+	/* rank r has probability proportional to 1/r^s, r = 1..N */
+	d->n = (size_t)d->b;
+	if (d->n < 1 || (d->cdf = (double *)malloc(d->n * sizeof(double))) == NULL) {
+	    fprintf(stderr, "gen_trace: bad zipf rank count\n");
+	    exit(1);
+	}
+	for (i = 0; i < d->n; i++)
+	    d->cdf[i] = (sum += pow(i + 1.0, -d->a));
+	for (i = 0; i < d->n; i++)
+	    d->cdf[i] /= sum;
+    }
+}
+
+/*
+ * Min-heap on obj_t.when
+ */
+static void heap_push(obj_t *o)
+{
+    size_t i, parent;
+
+    if (heapn == heapmax) {
+	heapmax = heapmax ? 2 * heapmax : 1024;
+	if ((heap = (obj_t *)realloc(heap, heapmax * sizeof(obj_t))) == NULL) {
+	    fprintf(stderr, "gen_trace: out of memory\n");
+	    exit(1);
+	}
+    }
+    for (i = heapn++; i > 0 && heap[parent = (i - 1) / 2].when > o->when; i = parent)
+	heap[i] = heap[parent];
+    heap[i] = *o;
+}
+
+static void heap_pop(obj_t *o)
+{
+    obj_t last;
+    size_t i = 0, child;
+
+    *o = heap[0];
+    last = heap[--heapn];
+    while ((child = 2 * i + 1) < heapn) {
+	if (child + 1 < heapn && heap[child + 1].when < heap[child].when)
+	    child++;
+	if (heap[child].when >= last.when)
+	    break;
+	heap[i] = heap[child];
+	i = child;
+    }
+    heap[i] = last;
+}
+
+/*
+ * emit - write one request and keep the live byte count up to date.
+ *     extra is the alignment of an 'm' request or the count of a batch.
+ */
+static void emit(char type, unsigned id, unsigned size, unsigned oldsize,
+		 unsigned extra)
+{
+    tf_op_t op;
+
+    op.type = type;
+    op.index = id;
+    op.size = size;
+    op.align = (type == 'm') ? extra : 0;
+    op.count = (type == 'A' || type == 'F') ? extra : 0;
+    tf_write(out, &op);
+    out->num_ops++;
+    live += ((double)size - oldsize) * (op.count ? op.count : 1);
+    if (live > peak)
+	peak = live;
+}
+
+/*
+ * next_event - process the earliest event of the object at the top of
+ *     the heap: either grow it and put it back, or free it. With force
+ *     set the object is freed even if it still had reallocs to come.
+ */
+static void next_event(double growth, int additive, unsigned maxsize, int force)
+{
+    obj_t o;
+    double newsize;
+
+    heap_pop(&o);
+    if (o.grows > 0 && !force) {
+	newsize = additive ? o.size + growth : o.size * growth;
+	if (newsize > maxsize)
+	    newsize = maxsize;
+	emit('r', o.id, (unsigned)newsize, o.size, 0);
+	o.size = (unsigned)newsize;
+	o.grows--;
+	o.when = o.grows ? o.when + o.step : o.death;
+	heap_push(&o);
+    } else if (o.count > 0) {
+	emit('F', o.id, 0, o.size, o.count);
+    } else {
+	emit('f', o.id, 0, o.size, 0);
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: gen_trace -n <allocs> -o <file> [-b] [-a <p>:<align>] [-B <p>:<n>]\n"
+	    "                 [-c <p>] [-s <seed>] [-d <size dist>] [-l <lifetime dist>]\n"
+	    "                 [-r <p>:<n>:<growth>] [-L <bytes>] [-M <bytes>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-a <p>:<align>\n"
+	    "\t           Allocate a fraction p of the objects with memalign,\n"
+	    "\t           aligned to align (a power of two).\n");
+    fprintf(stderr, "\t-b         Write the binary format instead of .rep text.\n");
+    fprintf(stderr, "\t-B <p>:<n> Make a fraction p of the allocations batches of n\n"
+	    "\t           objects of one size and lifetime, allocated and freed\n"
+	    "\t           together.\n");
+    fprintf(stderr, "\t-c <p>     Allocate a fraction p of the objects with calloc.\n");
+    fprintf(stderr, "\t-d <dist>  Request sizes (default uniform:1:32768):\n"
+	    "\t             uniform:MIN:MAX, lognormal:MEDIAN:SIGMA,\n"
+	    "\t             zipf:S:N[:STEP] (sizes STEP..N*STEP), bimodal:A:B:P,\n"
+	    "\t             empirical:TRACE (sizes of an existing trace).\n");
+    fprintf(stderr, "\t-l <dist>  Lifetimes in allocations (default exp:1000):\n"
+	    "\t             exp:MEAN, uniform:MIN:MAX, pareto:ALPHA:MIN,\n"
+	    "\t             lognormal:MEDIAN:SIGMA, fixed:N.\n");
+    fprintf(stderr, "\t-L <bytes> Free the objects closest to death early to keep\n"
+	    "\t           the live heap under <bytes>.\n");
+    fprintf(stderr, "\t-M <bytes> Largest request size (default 1048576).\n");
+    fprintf(stderr, "\t-n <n>     Number of objects to allocate.\n");
+    fprintf(stderr, "\t-o <file>  Output trace (must be a regular file).\n");
+    fprintf(stderr, "\t-r <p>:<n>:<growth>\n"
+	    "\t           A fraction p of the objects is realloc'd n times during\n"
+	    "\t           its life, each time multiplied by growth (e.g. 1.5) or,\n"
+	    "\t           if growth starts with '+', increased by it (e.g. +128).\n");
+    fprintf(stderr, "\t-s <seed>  Random seed (default 1).\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    dist_t sizes, lives;
+    char *outfile = NULL, *g;
+    char sizespec[MAXNAME] = "uniform:1:32768", lifespec[MAXNAME] = "exp:1000";
+    unsigned long long n = 0, t, seed = 1;
+    double target = 0, grow_p = 0, growth = 1, calloc_p = 0, size, life;
+    double align_p = 0, batch_p = 0;
+    unsigned maxsize = 1 << 20, grow_n = 0, align = 0, batch_n = 0;
+    int binary = 0, additive = 0, c;
+    char type;
+    obj_t o;
+
+    while ((c = getopt(argc, argv, "n:o:a:bB:c:s:d:l:r:L:M:h")) != EOF) {
+	switch (c) {
+	case 'n': n = strtoull(optarg, NULL, 10); break;
+	case 'o': outfile = optarg; break;
+	case 'a':
+	    if (sscanf(optarg, "%lf:%u", &align_p, &align) != 2 ||
+		align == 0 || (align & (align - 1)) != 0)
+		usage();
+	    break;
+	case 'b': binary = 1; break;
+	case 'B':
+	    if (sscanf(optarg, "%lf:%u", &batch_p, &batch_n) != 2 || batch_n == 0)
+		usage();
+	    break;
+	case 'c': calloc_p = atof(optarg); break;
+	case 's': seed = strtoull(optarg, NULL, 10); break;
+	case 'd': snprintf(sizespec, MAXNAME, "%s", optarg); break;
+	case 'l': snprintf(lifespec, MAXNAME, "%s", optarg); break;
+	case 'L': target = atof(optarg); break;
+	case 'M': maxsize = (unsigned)strtoul(optarg, NULL, 10); break;
+	case 'r':
+	    if (sscanf(optarg, "%lf:%u:", &grow_p, &grow_n) != 2 ||
+		(g = strrchr(optarg, ':')) == NULL)
+		usage();
+	    additive = (g[1] == '+');
+	    growth = atof(g + 1 + additive);
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (n == 0 || outfile == NULL || maxsize == 0)
+	usage();
+    parse_dist(&sizes, sizespec);
+    parse_dist(&lives, lifespec);
+
+    /* Seed through splitmix64 so that small seeds still mix well */
+    rng = seed + 0x9E3779B97F4A7C15ULL;
+    rng = (rng ^ (rng >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    rng = (rng ^ (rng >> 27)) * 0x94D049BB133111EBULL;
+    rng ^= rng >> 31;
+    if (rng == 0)
+	rng = 1;
+
+    if ((out = tf_create(outfile, binary)) == NULL) {
+	perror(outfile);
+	exit(1);
+    }
+
+    for (t = 0; t < n; t++) {
+	/* Everything due by now happens before the next allocation */
+	while (heapn > 0 && heap[0].when <= t)
+	    next_event(growth, additive, maxsize, 0);
+
+	size = floor(sample(&sizes));
+	if (size < 1)
+	    size = 1;
+	if (size > maxsize)
+	    size = maxsize;
+
+	/* A batch is batch_n objects of one size, born and freed together */
+	o.count = 0;
+	if (batch_p > 0 && rand_unit() < batch_p)
+	    o.count = (unsigned)(n - t < batch_n ? n - t : batch_n);
+
+	/* Make room under the live-heap target */
+	while (target > 0 && heapn > 0 &&
+	       live + size * (o.count ? o.count : 1) > target)
+	    next_event(growth, additive, maxsize, 1);
+
+	life = floor(sample(&lives));
+	if (life < 1)
+	    life = 1;
+	o.id = (unsigned)t;
+	o.size = (unsigned)size;
+	o.death = t + (unsigned long long)life;
+	o.grows = (grow_n > 0 && !o.count && rand_unit() < grow_p) ? grow_n : 0;
+	o.step = o.grows ? (unsigned long long)(life / (o.grows + 1)) : 0;
+	o.when = o.grows ? t + o.step : o.death;
+	if (o.count > 0) {
+	    emit('A', o.id, o.size, 0, o.count);
+	    heap_push(&o);
+	    t += o.count - 1;
+	    continue;
+	}
+	if (calloc_p > 0 && rand_unit() < calloc_p)
+	    type = 'c';
+	else if (align_p > 0 && rand_unit() < align_p)
+	    type = 'm';
+	else
+	    type = 'a';
+	emit(type, o.id, o.size, 0, type == 'm' ? align : 0);
+	heap_push(&o);
+    }
+
+    /* Let every remaining object run out its life */
+    while (heapn > 0)
+	next_event(growth, additive, maxsize, 0);
+
+    out->num_ids = (long long)n;
+    out->sugg_heapsize = (long long)peak + 100;
+    if (tf_close(out) < 0) {
+	perror(outfile);
+	exit(1);
+    }
+    return 0;
+}
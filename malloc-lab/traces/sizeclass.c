@@ -0,0 +1,98 @@
+/*
+ * sizeclass.c - choose size-class tables from a size histogram
+ *
+ * Rounding every block up to the smallest class that holds it wastes
+ * (class - size) bytes per request. For a fixed number of classes k
+ * the table minimizing the total waste is found by dynamic programming
+ * over the distinct sizes that occur: an optimal class boundary always
+ * sits on one of them, and the cost of a class covering a run of them
+ * comes from prefix sums in O(1), so each k costs O(d^2) for d
+ * distinct sizes.
+ */
+#include <stdlib.h>
+#include "sizeclass.h"
+
+/*
+ * sc_choose - Pick a class table for hist; see sizeclass.h
+ */
+int sc_choose(const double *hist, int n, int kmax, double waste_frac,
+	      unsigned *classes, double *waste)
+{
+    int *cand, *arg;
+    double *cnt, *sum, *dp;
+    double cost, best, total;
+    int d = 0, i, j, k, kbest, rc = -1;
+
+    if (kmax < 1)
+	kmax = 1;
+    cand = (int *)malloc((n + 2) * sizeof(int));
+    cnt = (double *)malloc((n + 3) * sizeof(double));
+    sum = (double *)malloc((n + 3) * sizeof(double));
+    dp = (double *)malloc((size_t)(kmax + 1) * (n + 3) * sizeof(double));
+    arg = (int *)malloc((size_t)(kmax + 1) * (n + 3) * sizeof(int));
+    if (!cand || !cnt || !sum || !dp || !arg)
+	goto out;
+
+    /* Candidate class sizes: every size that occurs, plus the largest */
+    for (i = SC_MINBLOCK / SC_GRAIN; i < n; i++)
+	if (hist[i] > 0)
+	    cand[d++] = i;
+    cand[d++] = n;
+    cnt[0] = sum[0] = 0;
+    for (j = 0; j < d; j++) {
+	cnt[j + 1] = cnt[j] + hist[cand[j]];
+	sum[j + 1] = sum[j] + hist[cand[j]] * cand[j] * SC_GRAIN;
+    }
+    total = sum[d];
+    if (kmax > d)
+	kmax = d;
+
+    /*
+     * dp[k][j]: least waste covering the first j candidates with k
+     * classes, the largest of which is cand[j-1]
+     */
+#define DP(k, j)  dp[(size_t)(k) * (d + 1) + (j)]
+#define ARG(k, j) arg[(size_t)(k) * (d + 1) + (j)]
+    for (j = 0; j <= d; j++)
+	DP(0, j) = (j == 0) ? 0 : -1;
+    kbest = kmax;
+    for (k = 1; k <= kmax; k++) {
+	for (j = 0; j <= d; j++) {
+	    DP(k, j) = -1;
+	    for (i = k - 1; i < j; i++) {
+		if (DP(k - 1, i) < 0)
+		    continue;
+		cost = DP(k - 1, i) + (double)cand[j - 1] * SC_GRAIN *
+		    (cnt[j] - cnt[i]) - (sum[j] - sum[i]);
+		if (DP(k, j) < 0 || cost < DP(k, j)) {
+		    DP(k, j) = cost;
+		    ARG(k, j) = i;
+		}
+	    }
+	}
+	if (DP(k, d) <= waste_frac * total) {
+	    kbest = k;
+	    break;
+	}
+    }
+
+    /* Walk the choices back from the last candidate */
+    best = DP(kbest, d);
+    for (k = kbest, j = d; k > 0; k--) {
+	classes[k - 1] = (unsigned)cand[j - 1] * SC_GRAIN;
+	j = ARG(k, j);
+    }
+    if (waste != NULL)
+	*waste = best;
+    rc = kbest;
+#undef DP
+#undef ARG
+
+ out:
+    free(cand);
+    free(cnt);
+    free(sum);
+    free(dp);
+    free(arg);
+    return rc;
+}
@@ -0,0 +1,32 @@
+/*
+ * sizeclass.h - choose size-class tables from a size histogram
+ *
+ * Sizes here are allocator block sizes (see SC_BLOCKSIZE), counted in
+ * units of SC_GRAIN bytes, so hist[i] is the number of requests whose
+ * block is exactly i * SC_GRAIN bytes.
+ */
+#ifndef __SIZECLASS_H_
+#define __SIZECLASS_H_
+
+/* Block granularity and the smallest block of mm.c */
+#define SC_GRAIN    8
+#define SC_MINBLOCK 16
+
+/* Block size mm.c uses for a request: 4-byte header and footer, 8-byte aligned */
+#define SC_BLOCKSIZE(size) \
+    ((size) <= 8 ? SC_MINBLOCK : (((size) + 8 + SC_GRAIN - 1) & ~(SC_GRAIN - 1)))
+
+/*
+ * Choose at most kmax classes covering block sizes up to n * SC_GRAIN
+ * (hist has n + 1 entries). Among the optimal tables with 1..kmax
+ * classes, returns the one with the fewest classes whose internal
+ * fragmentation is at most waste_frac of the bytes requested by
+ * blocks in range, or the kmax-class table if none is. Class sizes go
+ * to classes[] in increasing order, the last one always n * SC_GRAIN;
+ * the return value is their number, or -1 if out of memory. If waste
+ * is not NULL it gets the bytes lost to rounding up to a class.
+ */
+int sc_choose(const double *hist, int n, int kmax, double waste_frac,
+	      unsigned *classes, double *waste);
+
+#endif /* __SIZECLASS_H_ */
@@ -0,0 +1,235 @@
+/*
+ * tracefile.c - streaming reader and writer for Malloc Lab traces
+ *
+ * Binary layout (all integers little-endian):
+ *   8 bytes   TF_MAGIC
+ *   4 x 8     sugg_heapsize, num_ids, num_ops, weight
+ *   num_ops records of 9 bytes: type ('a', 'c', 'm', 'A', 'r', 'f' or
+ *     'F'), 4-byte id, 4-byte size; an 'm' record has a 4-byte
+ *     alignment after that, and an 'A' or 'F' record a 4-byte count
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tracefile.h"
+
+#define MAXLINE 1024
+#define HDRWIDTH 20 /* width of each header count in a text trace we write */
+
+/*
+ * get_le/put_le - decode and encode n-byte little-endian integers
+ */
+static unsigned long long get_le(const unsigned char *p, int n)
+{
+    unsigned long long v = 0;
+
+    while (n-- > 0)
+	v = (v << 8) | p[n];
+    return v;
+}
+
+static void put_le(unsigned char *p, unsigned long long v, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++, v >>= 8)
+	p[i] = (unsigned char)v;
+}
+
+/*
+ * tf_open - Open a trace for reading and parse its header
+ */
+tracefile_t *tf_open(const char *path)
+{
+    tracefile_t *tf;
+    unsigned char hdr[TF_MAGICLEN + 32];
+    long long *fields[4];
+    char line[MAXLINE];
+    int i;
+
+    if ((tf = (tracefile_t *)calloc(1, sizeof(tracefile_t))) == NULL)
+	return NULL;
+    if ((tf->fp = fopen(path, "rb")) == NULL) {
+	free(tf);
+	return NULL;
+    }
+    fields[0] = &tf->sugg_heapsize;
+    fields[1] = &tf->num_ids;
+    fields[2] = &tf->num_ops;
+    fields[3] = &tf->weight;
+
+    if (fread(hdr, 1, sizeof(hdr), tf->fp) == sizeof(hdr) &&
+	!memcmp(hdr, TF_MAGIC, TF_MAGICLEN)) {
+	tf->binary = 1;
+	for (i = 0; i < 4; i++)
+	    *fields[i] = (long long)get_le(hdr + TF_MAGICLEN + 8 * i, 8);
+	return tf;
+    }
+
+    /* A text trace: four lines of header */
+    rewind(tf->fp);
+    for (i = 0; i < 4; i++) {
+	if (fgets(line, MAXLINE, tf->fp) == NULL) {
+	    fclose(tf->fp);
+	    free(tf);
+	    return NULL;
+	}
+	*fields[i] = atoll(line);
+    }
+    tf->line = 4;
+    return tf;
+}
+
+/*
+ * tf_next - Read the next request
+ */
+int tf_next(tracefile_t *tf, tf_op_t *op)
+{
+    unsigned char rec[13];
+    char line[MAXLINE];
+    char *p, *end;
+
+    if (tf->binary) {
+	size_t n = fread(rec, 1, 9, tf->fp);
+	if (n == 0)
+	    return 0;
+	if (n != 9)
+	    return -1;
+	tf->line++;
+	op->type = (char)rec[0];
+	op->index = (unsigned)get_le(rec + 1, 4);
+	op->size = (unsigned)get_le(rec + 5, 4);
+	op->align = op->count = 0;
+	if (op->type == 'm' || op->type == 'A' || op->type == 'F') {
+	    if (fread(rec + 9, 1, 4, tf->fp) != 4)
+		return -1;
+	    if (op->type == 'm')
+		op->align = (unsigned)get_le(rec + 9, 4);
+	    else
+		op->count = (unsigned)get_le(rec + 9, 4);
+	}
+	return 1;
+    }
+
+    /* Text: skip blank lines, then "<type> <id> [<size>] [<align> | <count>]" */
+    do {
+	if (fgets(line, MAXLINE, tf->fp) == NULL)
+	    return 0;
+	tf->line++;
+	for (p = line; *p == ' ' || *p == '\t'; p++)
+	    ;
+    } while (*p == '\n' || *p == '\r' || *p == '\0');
+
+    op->type = *p++;
+    op->index = (unsigned)strtoul(p, &end, 10);
+    if (end == p)
+	return -1;
+    op->size = op->align = op->count = 0;
+    if (op->type != 'f' && op->type != 'F') {
+	p = end;
+	op->size = (unsigned)strtoul(p, &end, 10);
+	if (end == p)
+	    return -1;
+    }
+    if (op->type == 'm' || op->type == 'A' || op->type == 'F') {
+	p = end;
+	if (op->type == 'm')
+	    op->align = (unsigned)strtoul(p, &end, 10);
+	else
+	    op->count = (unsigned)strtoul(p, &end, 10);
+	if (end == p)
+	    return -1;
+    }
+    return 1;
+}
+
+/*
+ * write_header - write the header of a trace opened by tf_create
+ */
+static void write_header(tracefile_t *tf)
+{
+    unsigned char hdr[TF_MAGICLEN + 32];
+
+    if (tf->binary) {
+	memcpy(hdr, TF_MAGIC, TF_MAGICLEN);
+	put_le(hdr + TF_MAGICLEN, tf->sugg_heapsize, 8);
+	put_le(hdr + TF_MAGICLEN + 8, tf->num_ids, 8);
+	put_le(hdr + TF_MAGICLEN + 16, tf->num_ops, 8);
+	put_le(hdr + TF_MAGICLEN + 24, tf->weight, 8);
+	fwrite(hdr, 1, sizeof(hdr), tf->fp);
+    } else {
+	/* Fixed width, so the final counts fit over the placeholders */
+	fprintf(tf->fp, "%-*lld\n%-*lld\n%-*lld\n%-*lld\n",
+		HDRWIDTH, tf->sugg_heapsize, HDRWIDTH, tf->num_ids,
+		HDRWIDTH, tf->num_ops, HDRWIDTH, tf->weight);
+    }
+}
+
+/*
+ * tf_create - Create a trace for writing
+ */
+tracefile_t *tf_create(const char *path, int binary)
+{
+    tracefile_t *tf;
+
+    if ((tf = (tracefile_t *)calloc(1, sizeof(tracefile_t))) == NULL)
+	return NULL;
+    if ((tf->fp = fopen(path, binary ? "wb" : "w")) == NULL) {
+	free(tf);
+	return NULL;
+    }
+    tf->binary = binary;
+    tf->writing = 1;
+    tf->weight = 1;
+    write_header(tf);
+    return tf;
+}
+
+/*
+ * tf_write - Append one request to a trace
+ */
+void tf_write(tracefile_t *tf, const tf_op_t *op)
+{
+    unsigned char rec[13];
+
+    if (tf->binary) {
+	rec[0] = (unsigned char)op->type;
+	put_le(rec + 1, op->index, 4);
+	put_le(rec + 5, op->size, 4);
+	put_le(rec + 9, op->type == 'm' ? op->align : op->count, 4);
+	fwrite(rec, 1, (op->type == 'm' || op->type == 'A' ||
+			op->type == 'F') ? 13 : 9, tf->fp);
+    } else if (op->type == 'f') {
+	fprintf(tf->fp, "f %u\n", op->index);
+    } else if (op->type == 'F') {
+	fprintf(tf->fp, "F %u %u\n", op->index, op->count);
+    } else if (op->type == 'm') {
+	fprintf(tf->fp, "m %u %u %u\n", op->index, op->size, op->align);
+    } else if (op->type == 'A') {
+	fprintf(tf->fp, "A %u %u %u\n", op->index, op->size, op->count);
+    } else {
+	fprintf(tf->fp, "%c %u %u\n", op->type, op->index, op->size);
+    }
+}
+
+/*
+ * tf_close - Close a trace. For a trace being written, the caller has
+ *     filled in the header fields by now, so rewrite the header.
+ */
+int tf_close(tracefile_t *tf)
+{
+    int err = 0;
+
+    if (tf->writing) {
+	if (fseek(tf->fp, 0, SEEK_SET) != 0)
+	    err = -1;
+	else
+	    write_header(tf);
+	if (ferror(tf->fp))
+	    err = -1;
+    }
+    if (fclose(tf->fp) != 0)
+	err = -1;
+    free(tf);
+    return err;
+}
@@ -0,0 +1,61 @@
+/*
+ * tracefile.h - streaming reader and writer for Malloc Lab traces
+ *
+ * Traces come in two encodings with the same content (see README):
+ *   - the ASCII .rep format read by mdriver, and
+ *   - a compact binary format for very large traces, recognized by
+ *     the TF_MAGIC bytes at the start of the file.
+ *
+ * Requests are handed out one at a time, so tools that use this
+ * interface run in memory proportional to what they keep, not to the
+ * size of the trace.
+ */
+#ifndef __TRACEFILE_H_
+#define __TRACEFILE_H_
+
+#include <stdio.h>
+
+/* First bytes of a binary trace */
+#define TF_MAGIC "MMTRACE1"
+#define TF_MAGICLEN 8
+
+/* One request */
+typedef struct {
+    char type;           /* 'a', 'c', 'm', 'A', 'r', 'f' or 'F' */
+    unsigned index;      /* request id, the first of a batch */
+    unsigned size;       /* byte size of an 'a', 'c', 'm', 'A' or 'r' request */
+    unsigned align;      /* alignment of an 'm' request */
+    unsigned count;      /* number of ids in an 'A' or 'F' batch */
+} tf_op_t;
+
+/* An open trace, either being read or being written */
+typedef struct {
+    FILE *fp;
+    int binary;                /* binary encoding? */
+    int writing;               /* opened by tf_create? */
+    long long sugg_heapsize;   /* suggested heap size (unused) */
+    long long num_ids;         /* number of alloc/realloc ids */
+    long long num_ops;         /* number of requests */
+    long long weight;          /* weight for this trace (unused) */
+    long long line;            /* current line number, for messages */
+} tracefile_t;
+
+/* Open a trace for reading and parse its header; NULL on error */
+tracefile_t *tf_open(const char *path);
+
+/* Read the next request; returns 1 on success, 0 at the end, -1 on error */
+int tf_next(tracefile_t *tf, tf_op_t *op);
+
+/*
+ * Create a trace for writing. The header is written with placeholder
+ * counts that tf_close fills in, so path must be a regular file.
+ */
+tracefile_t *tf_create(const char *path, int binary);
+
+/* Append one request to a trace opened by tf_create */
+void tf_write(tracefile_t *tf, const tf_op_t *op);
+
+/* Close a trace, rewriting the header if it was being written */
+int tf_close(tracefile_t *tf);
+
+#endif /* __TRACEFILE_H_ */